@@ -12,10 +12,20 @@
 #include <shlobj.h>     // SHGetFolderPath, SHCreateDirectoryEx
 #include <shellapi.h>   // CommandLineToArgvW
 #include <cwctype>      // iswdigit
+#include <mmsystem.h>   // timeBeginPeriod
+#include <string>
+#include <vector>
 #include "resource/resource.h"
 #include "palette.h"
+#include "bitmap.h"
 #include "message.h"
 #include "matrix.h"
+#include "core/scheduler.h"
+#include "core/drawlist.h"
+#include "core/glyphset.h"
+#include "core/afterglow.h"
+#include "core/settings.h"
+#include "core/startup.h"
 
 #pragma comment(linker,"\"/manifestdependency:type='win32' \
 name='Microsoft.Windows.Common-Controls' version='6.0.0.0' \
@@ -23,6 +33,7 @@ processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 
 #pragma comment(lib, "comctl32")
 #pragma comment(lib, "shell32")
+#pragma comment(lib, "winmm")
 
 Message message;
 
@@ -35,6 +46,13 @@ RECT ScreenSize;
 HPALETTE hPalette;
 HDC hdcSymbols;
 HBITMAP hSymbolBitmap;
+HDC hdcRun;             // one column of cells, where glyph runs are put together
+HBITMAP hRunBitmap;
+HDC hdcGlow;            // the afterglow's framebuffer, when it is on
+HBITMAP hGlowBitmap;
+uint32_t *glowbits;
+Afterglow glow;
+DrawList drawlist;
 
 // state for matrix
 int dispx, dispy;
@@ -45,12 +63,22 @@ int xChar, yChar;
 HFONT hfont;
 
 int  MessageSpeed      = 150;   //
+int  MessageShimmer    = 25;    // 0..100, percent of message glyphs changed per frame
 int  Density           = 32;    // 5..50
 int  MatrixSpeed       = 5;     // 1..10
 int  FontSize          = 12;    // 8..30
 BOOL FontBold          = TRUE;
 BOOL RandomizeMessages = FALSE;
+int  StartupBudget     = 500;   // ms from launch to the first frame; 0 = no budget
+int  GlyphWidth        = 14;    // 4..64, cell size of GlyphSheet
+int  GlyphHeight       = 14;
+int  GlyphCount        = 0;     // glyphs taken from GlyphSheet; 0 = all
+int  Shades            = SHADES_DEFAULT;    // 16..64, steps from black to the Theme colour
+int  AfterglowKeep     = 0;     // 0..95, percent of its glow a pixel keeps per frame; 0 = off
 TCHAR szFontName[512]  = _T("MS Sans Serif");
+TCHAR szGlyphSheet[MAX_PATH];   // a .bmp of glyphs to use instead of matrix.bmp's
+TCHAR szTheme[32];              // green, amber or RRGGBB; empty for the glyphs' own colours
+BmpImage glyphatlas;            // built from szGlyphSheet and szTheme, empty if neither is set
 
 // Portable versions (renamed to avoid collisions with original project files)
 static void LoadSettingsPortable(void);
@@ -71,25 +99,19 @@ bool fScreenSaving = false;
 HDC     hdcMessage;
 HBITMAP hBitmapMsg;
 
-int jjrand(void)
-{
-    static unsigned short reg = (unsigned short)(GetTickCount() & 0xffff);
-    unsigned short mask = 0xb400;
-
-    if (reg & 1) reg = (reg >> 1) ^ mask;
-    else         reg = (reg >> 1);
-
-    return reg;
-}
-
-Matrix* matrix;
-
-inline int INTENSITY(int n) { return (n < 0 ? -1 : n/32); }
+MatrixEngine engine;
 
 // ===================== Portable settings (INI) with fallback =====================
 
 static const TCHAR* kCfgFileName = _T("matrix-settings-portable.cfg");
 static const TCHAR* kIniSection  = _T("Settings");
+static const TCHAR* kMaskCacheName = _T("matrix-masks.cache");
+static const TCHAR* kSnapFileName  = _T("matrix-settings.snapshot");
+static const TCHAR* kStartupLogName = _T("matrix-startup.log");
+
+// launch to first frame, phase by phase
+static SteadyClock     startclock;
+static StartupProfiler startup(&startclock);
 static TCHAR gCfgPath[MAX_PATH]  = {0};   // cache for UI display
 
 static BOOL IsFolderWritable(const TCHAR* folder) {
@@ -161,157 +183,429 @@ static void GetConfigPath(TCHAR* outPath, size_t cchOut) {
     lstrcpyn(outPath, kCfgFileName, (int)cchOut);
 }
 
-static void ClampSettings() {
-    if (Density     < 5)  Density     = 5;
-    if (Density     > 50) Density     = 50;
-    if (MatrixSpeed < 1)  MatrixSpeed = 1;
-    if (MatrixSpeed > 10) MatrixSpeed = 10;
-    if (FontSize    < 8)  FontSize    = 8;
-    if (FontSize    > 30) FontSize    = 30;
+// ---- settings globals <-> MatrixSettings (core/settings.h) ----
+
+static std::string ToUtf8(const TCHAR* str) {
+    std::string out;
+#ifdef UNICODE
+    int n = WideCharToMultiByte(CP_UTF8, 0, str, -1, NULL, 0, NULL, NULL);
+    if (n > 1) {
+        out.resize(n);
+        WideCharToMultiByte(CP_UTF8, 0, str, -1, &out[0], n, NULL, NULL);
+        out.resize(n - 1);
+    }
+#else
+    out = str;
+#endif
+    return out;
 }
 
-static void LoadSettingsPortable(void) {
-    GetConfigPath(gCfgPath, MAX_PATH);
+static void FromUtf8(const std::string& str, TCHAR* out, int cchOut) {
+#ifdef UNICODE
+    std::vector<WCHAR> wide(str.size() + 1);
+    if (!MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, &wide[0], (int)wide.size())) wide[0] = 0;
+    lstrcpyn(out, &wide[0], cchOut);
+#else
+    lstrcpyn(out, str.c_str(), cchOut);
+#endif
+}
 
-    MessageSpeed      = GetPrivateProfileInt(kIniSection, _T("MessageSpeed"),      MessageSpeed,      gCfgPath);
-    Density           = GetPrivateProfileInt(kIniSection, _T("Density"),           Density,           gCfgPath);
-    MatrixSpeed       = GetPrivateProfileInt(kIniSection, _T("MatrixSpeed"),       MatrixSpeed,       gCfgPath);
-    FontSize          = GetPrivateProfileInt(kIniSection, _T("FontSize"),          FontSize,          gCfgPath);
-    FontBold          = GetPrivateProfileInt(kIniSection, _T("FontBold"),          FontBold,          gCfgPath) ? TRUE : FALSE;
-    RandomizeMessages = GetPrivateProfileInt(kIniSection, _T("RandomizeMessages"), RandomizeMessages, gCfgPath) ? TRUE : FALSE;
+static void GlobalsToSettings(MatrixSettings& s) {
+    s.messagespeed = MessageSpeed;
+    s.shimmer      = MessageShimmer;
+    s.density      = Density;
+    s.matrixspeed  = MatrixSpeed;
+    s.fontsize     = FontSize;
+    s.startupbudget = StartupBudget;
+    s.glyphwidth   = GlyphWidth;
+    s.glyphheight  = GlyphHeight;
+    s.glyphcount   = GlyphCount;
+    s.shades       = Shades;
+    s.afterglow    = AfterglowKeep;
+    s.fontbold     = FontBold != FALSE;
+    s.randomize    = RandomizeMessages != FALSE;
+    s.fontname     = ToUtf8(szFontName);
+    s.feedpath     = ToUtf8(szFeedPath);
+    s.glyphsheet   = ToUtf8(szGlyphSheet);
+    s.theme        = ToUtf8(szTheme);
+}
 
-    GetPrivateProfileString(kIniSection, _T("FontName"), szFontName, szFontName,
-                            (DWORD)(sizeof(szFontName)/sizeof(szFontName[0])), gCfgPath);
+static void SettingsToGlobals(const MatrixSettings& s) {
+    MessageSpeed      = s.messagespeed;
+    MessageShimmer    = s.shimmer;
+    Density           = s.density;
+    MatrixSpeed       = s.matrixspeed;
+    FontSize          = s.fontsize;
+    StartupBudget     = s.startupbudget;
+    GlyphWidth        = s.glyphwidth;
+    GlyphHeight       = s.glyphheight;
+    GlyphCount        = s.glyphcount;
+    Shades            = s.shades;
+    AfterglowKeep     = s.afterglow;
+    FontBold          = s.fontbold  ? TRUE : FALSE;
+    RandomizeMessages = s.randomize ? TRUE : FALSE;
+    FromUtf8(s.fontname, szFontName, (int)(sizeof(szFontName)/sizeof(szFontName[0])));
+    FromUtf8(s.feedpath, szFeedPath, MAX_PATH);
+    FromUtf8(s.glyphsheet, szGlyphSheet, MAX_PATH);
+    FromUtf8(s.theme, szTheme, (int)(sizeof(szTheme)/sizeof(szTheme[0])));
+}
 
-    ClampSettings();
+static void ClampGlobals() {
+    MatrixSettings s;
+    GlobalsToSettings(s);
+    ClampSettings(s);
+    SettingsToGlobals(s);
 }
 
-static void SaveSettingsPortable(void) {
-    TCHAR buf[32];
+// ---- settings snapshot: skips the folder probe and the INI parse ----
 
-    _stprintf_s(buf, _T("%d"), MessageSpeed);      WritePrivateProfileString(kIniSection, _T("MessageSpeed"),      buf, gCfgPath);
-    _stprintf_s(buf, _T("%d"), Density);           WritePrivateProfileString(kIniSection, _T("Density"),           buf, gCfgPath);
-    _stprintf_s(buf, _T("%d"), MatrixSpeed);       WritePrivateProfileString(kIniSection, _T("MatrixSpeed"),       buf, gCfgPath);
-    _stprintf_s(buf, _T("%d"), FontSize);          WritePrivateProfileString(kIniSection, _T("FontSize"),          buf, gCfgPath);
-    _stprintf_s(buf, _T("%d"), FontBold ? 1 : 0);  WritePrivateProfileString(kIniSection, _T("FontBold"),          buf, gCfgPath);
-    _stprintf_s(buf, _T("%d"), RandomizeMessages ? 1 : 0);
-    WritePrivateProfileString(kIniSection, _T("RandomizeMessages"), buf, gCfgPath);
+static BOOL ReadWholeFile(const TCHAR* path, std::vector<char>& data) {
+    HANDLE h = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE) return FALSE;
+    DWORD size = GetFileSize(h, NULL), got = 0;
+    BOOL ok = size != INVALID_FILE_SIZE && size < (1u << 20);
+    if (ok) {
+        data.resize(size);
+        ok = size == 0 || (ReadFile(h, &data[0], size, &got, NULL) && got == size);
+    }
+    CloseHandle(h);
+    return ok;
+}
 
-    WritePrivateProfileString(kIniSection, _T("FontName"), szFontName, gCfgPath);
+static BOOL WriteWholeFile(const TCHAR* path, const void* data, DWORD size) {
+    HANDLE h = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE) return FALSE;
+    DWORD put = 0;
+    BOOL ok = WriteFile(h, data, size, &put, NULL) && put == size;
+    CloseHandle(h);
+    if (!ok) DeleteFile(path);
+    return ok;
+}
+
+// size and write time of the settings file; zero for a file that isn't there
+static void GetFileStamp(const TCHAR* path, uint64_t& size, uint64_t& time) {
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    size = time = 0;
+    if (GetFileAttributesEx(path, GetFileExInfoStandard, &fad)) {
+        size = (uint64_t)fad.nFileSizeHigh << 32 | fad.nFileSizeLow;
+        time = (uint64_t)fad.ftLastWriteTime.dwHighDateTime << 32 | fad.ftLastWriteTime.dwLowDateTime;
+    }
 }
 
-// ===================== Matrix render code (unchanged) =====================
+// SettingsHash of the settings file; of nothing for a file that isn't there
+static uint32_t GetFileHash(const TCHAR* path) {
+    std::vector<char> data;
+    if (!ReadWholeFile(path, data) || data.empty()) return SettingsHash("", 0);
+    return SettingsHash(&data[0], data.size());
+}
 
-void Matrix::ScrollDown(HDC hdc)
-{
-    if (started == false) {
-        if (--initcount <= 0) started = true;
-        return;
+// swap the file name at the end of path for name
+static BOOL ReplaceFileName(TCHAR* path, const TCHAR* name) {
+    TCHAR* slash = _tcsrchr(path, TEXT('\\'));
+    TCHAR* tail  = slash ? slash + 1 : path;
+    if ((tail - path) + lstrlen(name) + 1 >= MAX_PATH) { path[0] = 0; return FALSE; }
+    lstrcpy(tail, name);
+    return TRUE;
+}
+
+// where a snapshot may be, in the order GetConfigPath prefers folders
+static BOOL GetSnapshotCandidate(int which, TCHAR* out) {
+    if (which == 0) {
+        DWORD n = GetModuleFileName(NULL, out, (DWORD)MAX_PATH);
+        return n && n < MAX_PATH && ReplaceFileName(out, kSnapFileName);
     }
+    TCHAR appdata[MAX_PATH];
+    if (FAILED(SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, SHGFP_TYPE_CURRENT, appdata))) return FALSE;
+    return _sntprintf_s(out, MAX_PATH, _TRUNCATE, _T("%s\\Matrix\\%s"), appdata, kSnapFileName) >= 0;
+}
 
-    for (int i = 0; i < numrows; i++) update[i] = false;
+// a snapshot still describing the settings file it came from
+static BOOL LoadSnapshot(SettingsSnapshot& snap) {
+    for (int i = 0; i < 2; i++) {
+        TCHAR path[MAX_PATH];
+        std::vector<char> data;
+        if (!GetSnapshotCandidate(i, path) || !ReadWholeFile(path, data) || data.empty()) continue;
+        if (!DecodeSnapshot(&data[0], data.size(), snap)) continue;
+
+        TCHAR cfg[MAX_PATH];
+        uint64_t size, time;
+        FromUtf8(snap.path, cfg, MAX_PATH);
+        GetFileStamp(cfg, size, time);
+        if (cfg[0] && size == snap.size && time == snap.time && GetFileHash(cfg) == snap.hash) return TRUE;
+    }
+    return FALSE;
+}
 
-    int oldchar = state ? 127 : -1;
+// written next to the settings file, whose folder is known to be writable
+static void SaveSnapshot(void) {
+    SettingsSnapshot snap;
+    GlobalsToSettings(snap.settings);
+    snap.path = ToUtf8(gCfgPath);
+    GetFileStamp(gCfgPath, snap.size, snap.time);
+    snap.hash = GetFileHash(gCfgPath);
+
+    TCHAR path[MAX_PATH];
+    lstrcpyn(path, gCfgPath, MAX_PATH);
+    if (!ReplaceFileName(path, kSnapFileName)) return;
+
+    std::vector<uint8_t> data;
+    EncodeSnapshot(snap, data);
+    WriteWholeFile(path, &data[0], (DWORD)data.size());
+}
 
-    for (int i = 0; i < numrows; i++) {
-        int oldins = INTENSITY(oldchar);
-        int runins = INTENSITY(run[i]);
+// the INI as UTF-8: it may be UTF-16 (with a BOM), UTF-8 (with a BOM) or ANSI
+static std::string ReadIniText(const TCHAR* path) {
+    std::vector<char> data;
+    std::string text;
+    if (!ReadWholeFile(path, data) || data.empty()) return text;
+
+    std::vector<WCHAR> wide;
+    if (data.size() >= 2 && (BYTE)data[0] == 0xff && (BYTE)data[1] == 0xfe) {
+        if (data.size() > 2)
+            wide.assign((const WCHAR*)&data[2], (const WCHAR*)&data[2] + (data.size() - 2) / 2);
+    } else if (data.size() >= 3 && (BYTE)data[0] == 0xef && (BYTE)data[1] == 0xbb && (BYTE)data[2] == 0xbf) {
+        return std::string(data.begin(), data.end());
+    } else {
+        int n = MultiByteToWideChar(CP_ACP, 0, &data[0], (int)data.size(), NULL, 0);
+        if (n <= 0) return text;
+        wide.resize(n);
+        MultiByteToWideChar(CP_ACP, 0, &data[0], (int)data.size(), &wide[0], n);
+    }
+    if (wide.empty()) return text;
 
-        if (runins > oldins && runins >= 0) {
-            run[i] -= 32;
-            update[i] = true;
-            if (runins == 3) i++;
-        } else if (oldins >= 0 && runins < 0) {
-            run[i] = jjrand() % 26 + 96;
-            update[i] = true;
-            i++;
-        }
-        oldchar = run[i];
+    int n = WideCharToMultiByte(CP_UTF8, 0, &wide[0], (int)wide.size(), NULL, 0, NULL, NULL);
+    if (n > 0) {
+        text.resize(n);
+        WideCharToMultiByte(CP_UTF8, 0, &wide[0], (int)wide.size(), &text[0], n, NULL, NULL);
     }
+    return text;
+}
 
-    if (--statecount <= 0) {
-        state ^= 1;
-        if (state == 0)  statecount = jjrand() % (DENSITY_MAX + 1 - Density) + (DENSITY_MIN * 2);
-        else             statecount = jjrand() % (3 * Density / 2) + DENSITY_MIN;
+static void LoadSettingsPortable(void) {
+    SettingsSnapshot snap;
+
+    if (LoadSnapshot(snap)) {
+        // the file hasn't changed since it was last read
+        FromUtf8(snap.path, gCfgPath, MAX_PATH);
+        SettingsToGlobals(snap.settings);
+        startup.Mark("settings snapshot");
+    } else {
+        startup.Mark("snapshot miss");
+        GetConfigPath(gCfgPath, MAX_PATH);
+        startup.Mark("config path probe");
+
+        // one pass over the file, starting from the defaults
+        MatrixSettings s;
+        GlobalsToSettings(s);
+        std::string text = ReadIniText(gCfgPath);
+        ParseSettings(text.data(), text.size(), "Settings", s);
+        ClampSettings(s);
+        SettingsToGlobals(s);
+        startup.Mark("settings parse");
+
+        SaveSnapshot();
+        startup.Mark("snapshot write");
     }
 
-    if (blippos >= 0 && blippos < runlen) {
-        update[blippos]   = true;
-        update[blippos+1] = true;
-        update[blippos+8] = true;
-        update[blippos+9] = true;
+    // rasterized message masks are cached alongside
+    lstrcpyn(szMaskCachePath, gCfgPath, MAX_PATH);
+    ReplaceFileName(szMaskCachePath, kMaskCacheName);
+}
+
+// GlyphSheet and Theme, if set, become glyphatlas and set the cell size
+static void LoadGlyphs(void) {
+    BmpSource  src;
+    BmpImage   sheet;
+    ColorTheme theme;
+    std::string name = ToUtf8(szTheme);
+    bool themed = !name.empty() && ParseTheme(name.c_str(), theme);
+    int  cellw = GlyphWidth, cellh = GlyphHeight, count = GlyphCount;
+
+    // the afterglow works in a theme's shades; green is matrix.bmp's own
+    if (AfterglowKeep > 0 && !themed)
+        themed = ParseTheme("green", theme);
+
+    glyphatlas = BmpImage();
+
+    // a sheet in a format ParseBmp doesn't take shows up in the startup breakdown
+    BOOL opened = szGlyphSheet[0] && OpenBmp(0, szGlyphSheet, &src);
+    if (szGlyphSheet[0] && !opened)
+        startup.Mark("glyph sheet unreadable");
+
+    if (opened) {
+        DecodeView(src.view, sheet);
+        CloseBmp(&src);
+    } else if (themed && OpenBmp(hInst, MAKEINTRESOURCE(IDB_BITMAP1), &src)) {
+        // matrix.bmp's own glyphs, recoloured
+        BmpImage atlas;
+        DecodeView(src.view, atlas);
+        CloseBmp(&src);
+        AtlasSheet(atlas, MATRIX_NUMGLYPHS, sheet);
+        cellw = sheet.width / MATRIX_NUMGLYPHS;
+        cellh = sheet.height;
+        count = MATRIX_NUMGLYPHS;
+    } else {
+        return;
     }
 
-    blippos += 2;
+    int made;
+    if (themed) {
+        ShadeTable shades;
+        shades.Create(theme, Shades);
+        made = BuildThemeAtlas(sheet, cellw, cellh, count, shades, glyphatlas);
 
-    if (blippos >= bliplen) {
-        bliplen = numrows + jjrand() % 50;
-        blippos = 0;
+        std::vector<uint8_t> glowing;
+        if (made && AfterglowKeep > 0 && BuildGlowAtlas(sheet, cellw, cellh, count, shades, glowing))
+            glow.SetAtlas(glowing, made, cellw, cellh, shades);
+    } else {
+        made = BuildGlyphAtlas(sheet, cellw, cellh, count, glyphatlas);
+    }
+
+    if (made) {
+        xChar = cellw;
+        yChar = cellh;
     }
+    startup.Mark("glyphs");
+}
 
-    if (blippos >= 0 && blippos < runlen) {
-        update[blippos]   = true;
-        update[blippos+1] = true;
-        update[blippos+8] = true;
-        update[blippos+9] = true;
+// always to the debugger; over budget, also to matrix-startup.log next to the settings
+static void ReportStartup(void) {
+    std::string text;
+    int64_t budget = (int64_t)StartupBudget * 1000;
+    startup.Report(text, budget);
+    OutputDebugStringA(text.c_str());
+
+    if (startup.OverBudget(budget)) {
+        TCHAR path[MAX_PATH];
+        lstrcpyn(path, gCfgPath, MAX_PATH);
+        if (ReplaceFileName(path, kStartupLogName))
+            WriteWholeFile(path, text.data(), (DWORD)text.size());
     }
 }
 
-void DecodeMatrix(HWND hwnd)
+static void SaveSettingsPortable(void) {
+    TCHAR buf[32];
+
+    _stprintf_s(buf, _T("%d"), MessageSpeed);      WritePrivateProfileString(kIniSection, _T("MessageSpeed"),      buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), Density);           WritePrivateProfileString(kIniSection, _T("Density"),           buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), MatrixSpeed);       WritePrivateProfileString(kIniSection, _T("MatrixSpeed"),       buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), FontSize);          WritePrivateProfileString(kIniSection, _T("FontSize"),          buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), FontBold ? 1 : 0);  WritePrivateProfileString(kIniSection, _T("FontBold"),          buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), MessageShimmer);    WritePrivateProfileString(kIniSection, _T("MessageShimmer"),    buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), StartupBudget);     WritePrivateProfileString(kIniSection, _T("StartupBudget"),     buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), GlyphWidth);        WritePrivateProfileString(kIniSection, _T("GlyphWidth"),        buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), GlyphHeight);       WritePrivateProfileString(kIniSection, _T("GlyphHeight"),       buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), GlyphCount);        WritePrivateProfileString(kIniSection, _T("GlyphCount"),        buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), Shades);            WritePrivateProfileString(kIniSection, _T("Shades"),            buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), AfterglowKeep);     WritePrivateProfileString(kIniSection, _T("Afterglow"),         buf, gCfgPath);
+    _stprintf_s(buf, _T("%d"), RandomizeMessages ? 1 : 0);
+    WritePrivateProfileString(kIniSection, _T("RandomizeMessages"), buf, gCfgPath);
+
+    WritePrivateProfileString(kIniSection, _T("FontName"), szFontName, gCfgPath);
+    WritePrivateProfileString(kIniSection, _T("MessageFeed"), szFeedPath, gCfgPath);
+    WritePrivateProfileString(kIniSection, _T("GlyphSheet"), szGlyphSheet, gCfgPath);
+    WritePrivateProfileString(kIniSection, _T("Theme"), szTheme, gCfgPath);
+
+    SaveSnapshot();
+}
+
+// ===================== Matrix render code =====================
+
+// run the steps the scheduler says are due, then draw everything they changed
+void DecodeMatrix(HWND hwnd, int steps)
 {
+    for (int i = 0; i < steps; i++) {
+        engine.Step();
+        StepMessages();
+    }
+
     HDC hdc = GetDC(hwnd);
 
-    UseNicePalette(hdc, hPalette);
+    if (hPalette) UseNicePalette(hdc, hPalette);
     SelectObject(hdc, hfont);
     SetBkColor(hdc, 0);
 
-    for (int x = 0; x < numcols; x++) {
-        matrix[x].jjrandomise();
-        matrix[x].ScrollDown(hdc);
-
-        for (int y = 0; y < numrows; y++) {
-            if (!matrix[x].update[y]) continue;
-
-            if (matrix[x].run[y] < 0) {
-                RECT rect;
-                SetRect(&rect,  x * xChar, y * yChar, (x + 1) * xChar, (y + 1) * yChar);
-                ExtTextOut(hdc, x * xChar, y * yChar, ETO_OPAQUE, &rect, _T(""), 0, 0);
-            } else {
-                if (matrix[x].blippos == y  || matrix[x].blippos+1 == y
-                 || matrix[x].blippos+8 == y || matrix[x].blippos+9 == y) {
-                    TCHAR c = (TCHAR)(matrix[x].run[y] & 31);
-                    BitBlt(hdc, x*xChar, y*yChar, 14, 14, hdcSymbols, c*14, 14*4, SRCCOPY);
-                } else {
-                    TCHAR c = (TCHAR)matrix[x].run[y];
-                    int sx = c & 31;
-                    int sy = c / 32;
-                    BitBlt(hdc, x*xChar, y*yChar, 14, 14, hdcSymbols, sx*14, sy*14, SRCCOPY);
-                }
+    // runs of blanks are one fill, runs of glyphs one blit through hdcRun;
+    // the messages go in the same list, drawn after the rain
+    drawlist.Build(engine);
+    DoMessages(drawlist);
+    engine.ClearDirty();
+
+    // the afterglow redraws whatever is still fading, not just the list
+    if (glowbits) {
+        GdiFlush();
+        glow.Draw(drawlist, glowbits, glow.Width(), engine.Pool());
+
+        for (int b = 0; b < glow.Bands(); b++) {
+            int x0, x1, y = b * glow.CellHeight();
+            if (glow.Changed(b, x0, x1))
+                BitBlt(hdc, x0, y, x1 - x0, glow.CellHeight(), hdcGlow, x0, y, SRCCOPY);
+        }
+
+        ReleaseDC(hwnd, hdc);
+        return;
+    }
+
+    const uint16_t *cells = drawlist.Cells();
+    int glyphs = engine.NumGlyphs();
+
+    for (int i = 0; i < drawlist.Size(); i++) {
+        const DrawCmd &c = drawlist[i];
+        int px = c.x * xChar, py = c.y * yChar;
+
+        if (c.op == DRAW_FILL) {
+            RECT rect;
+            SetRect(&rect, px, py, px + xChar, py + c.count * yChar);
+            ExtTextOut(hdc, px, py, ETO_OPAQUE, &rect, _T(""), 0, 0);
+        } else if (c.count == 1) {
+            int n = cells[c.first];
+            BitBlt(hdc, px, py, xChar, yChar, hdcSymbols, (n % glyphs) * xChar, (n / glyphs) * yChar, SRCCOPY);
+        } else {
+            for (int k = 0; k < c.count; k++) {
+                int n = cells[c.first + k];
+                BitBlt(hdcRun, 0, k * yChar, xChar, yChar, hdcSymbols, (n % glyphs) * xChar, (n / glyphs) * yChar, SRCCOPY);
             }
+            BitBlt(hdc, px, py, xChar, c.count * yChar, hdcRun, 0, 0, SRCCOPY);
         }
     }
 
-    DoMessages(hdc);
     ReleaseDC(hwnd, hdc);
 }
 
-void Matrix::jjrandomise()
+void PresentFrame(HWND hwnd, int steps)
 {
-    int p = 0;
-    for (int i = 1; i < 20; i++) {
-        while (run[p] < 96 && p < numrows) p++;
-        if (p >= numrows) break;
-        run[p] = jjrand() % 26 + 96;
-        update[p] = true;
-        p += jjrand() % 10;
+    static LARGE_INTEGER freq;
+    static DWORD         median;
+    static int           fpscount;
+    LARGE_INTEGER        pc1, pc2;
+
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+
+    if (!fScreenSaving) QueryPerformanceCounter(&pc1);
+
+    DecodeMatrix(hwnd, steps);
+
+    if (!fScreenSaving) {
+        QueryPerformanceCounter(&pc2);
+        TCHAR buf[192];
+        median += DWORD(DWORD(freq.QuadPart) / DWORD(pc2.QuadPart - pc1.QuadPart));
+        if (++fpscount == 16) {
+            int len = wsprintf(buf, _T("%s - %u FPS - %d calls for %d cells"), szAppName, median / 16,
+                               drawlist.Size(), drawlist.DirtyCells());
+            unsigned lines, dropped;
+            if (MessageFeedStats(lines, dropped))
+                wsprintf(buf + len, _T(" - feed %u lines, %u dropped"), lines, dropped);
+            SetWindowText(hwnd, buf);
+            median = 0; fpscount = 0;
+        }
     }
 }
 
 void InitMatrix(HWND hwnd)
 {
-    matrix = new Matrix[maxcols];
-    for (int i = 0; i < maxcols; i++) matrix[i].Init(maxrows);
-    SetTimer(hwnd, 0xDeadBeef, MatrixSpeed * 10, 0);
+    engine.Create(maxcols, maxrows, Density, GetTickCount());
+    engine.SetThreads(0);
+    engine.SetGlyphs(glyphatlas.width ? glyphatlas.width / xChar : MATRIX_NUMGLYPHS);
 }
 
 // ===================== Normal app / saver plumbing =====================
@@ -364,20 +658,32 @@ static void ParseScreensaverArgs(SsArgs* out) {
 
 int APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE, LPTSTR /*lpCmdLine*/, int iCmdShow)
 {
+    startup.Begin();
     hInst = hInstance;
 
     // Single-instance guard
     if (FindWindowEx(NULL, NULL, szAppName, szAppName)) return 0;
 
-    SetRect(&ScreenSize, 0, 0, GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN));
-
-    xChar = 14; yChar = 14;
-    maxcols = ScreenSize.right / xChar;
-    maxrows = ScreenSize.bottom / yChar + 1;
+    // the whole virtual desktop, so the grid covers every monitor
+    int vx = GetSystemMetrics(SM_XVIRTUALSCREEN),  vy = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    int vw = GetSystemMetrics(SM_CXVIRTUALSCREEN), vh = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    if (vw <= 0 || vh <= 0) {
+        vx = vy = 0;
+        vw = GetSystemMetrics(SM_CXSCREEN);
+        vh = GetSystemMetrics(SM_CYSCREEN);
+    }
+    SetRect(&ScreenSize, vx, vy, vx + vw, vy + vh);
+    startup.Mark("desktop geometry");
 
     // Portable settings loader
     LoadSettingsPortable();
 
+    // the cell size comes from the glyphs in use
+    xChar = 14; yChar = 14;
+    LoadGlyphs();
+    maxcols = (ScreenSize.right - ScreenSize.left) / xChar;
+    maxrows = (ScreenSize.bottom - ScreenSize.top) / yChar + 1;
+
     // Parse /s /p /c /a (robust & Unicode-safe)
     SsArgs a{}; ParseScreensaverArgs(&a);
 
@@ -398,17 +704,12 @@ int main(void) {}
 
 LRESULT CALLBACK WndProc (HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lParam)
 {
-    int i, j;
     HDC hdc;
     static HANDLE    holddc;
     static HPALETTE  holdpal;
     static bool      fHere = false;
     static POINT     ptLast;
     POINT            ptCursor, ptCheck;
-    static LARGE_INTEGER freq;
-    LARGE_INTEGER    pc1, pc2;
-    static DWORD     median;
-    static int       fpscount;
 
     switch (iMsg)
     {
@@ -418,63 +719,82 @@ LRESULT CALLBACK WndProc (HWND hwnd, UINT iMsg, WPARAM wParam, LPARAM lParam)
         holdpal = UseNicePalette(hdc, hPalette);
         hdcSymbols = CreateCompatibleDC(hdc);
 
-        // load bitmap as a DDB, with palette!
-        hPalette = ReadBMPPalette(hInst, hdc, MAKEINTRESOURCE(IDB_BITMAP1));
-        extern HBITMAP hDDB;
-        hSymbolBitmap = hDDB;
+        // load bitmap as a DDB; a palette only for palette displays,
+        // where it has to be realized every frame
+        if (!(GetDeviceCaps(hdc, RASTERCAPS) & RC_PALETTE)) {
+            hPalette = 0;
+            hSymbolBitmap = glyphatlas.width ? CreateImageBitmap(hdc, glyphatlas)
+                                             : LoadBitmap2(hdc, hInst, MAKEINTRESOURCE(IDB_BITMAP1));
+        } else if (glyphatlas.width) {
+            hPalette = CreateHalftonePalette(hdc);
+            UseNicePalette(hdc, hPalette);
+            hSymbolBitmap = CreateImageBitmap(hdc, glyphatlas);
+        } else {
+            hPalette = ReadBMPPalette(hInst, hdc, MAKEINTRESOURCE(IDB_BITMAP1));
+            extern HBITMAP hDDB;
+            hSymbolBitmap = hDDB;
+        }
+        startup.Mark("glyph bitmap");
 
         holddc = (HANDLE)SelectObject(hdcSymbols, hSymbolBitmap);
 
+        // staging column for glyph runs, as tall as the screen
+        hdcRun     = CreateCompatibleDC(hdc);
+        hRunBitmap = CreateCompatibleBitmap(hdc, xChar, maxrows * yChar);
+        SelectObject(hdcRun, hRunBitmap);
+        if (hPalette) SelectPalette(hdcRun, hPalette, FALSE);
+
+        // the afterglow draws the whole desktop into a DIB, blitted band by band
+        if (AfterglowKeep > 0 && glyphatlas.width) {
+            int w = ScreenSize.right - ScreenSize.left, h = ScreenSize.bottom - ScreenSize.top;
+
+            glow.Create(w, h);
+            glow.SetKeep(AfterglowKeep * 256 / 100);
+
+            BITMAPINFO bi = { 0 };
+            bi.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
+            bi.bmiHeader.biWidth       = w;
+            bi.bmiHeader.biHeight      = -h;    // top row first
+            bi.bmiHeader.biPlanes      = 1;
+            bi.bmiHeader.biBitCount    = 32;
+            bi.bmiHeader.biCompression = BI_RGB;
+
+            void *bits = 0;
+            hGlowBitmap = CreateDIBSection(hdc, &bi, DIB_RGB_COLORS, &bits, NULL, 0);
+            if (hGlowBitmap && glow.Width()) {
+                hdcGlow  = CreateCompatibleDC(hdc);
+                SelectObject(hdcGlow, hGlowBitmap);
+                glowbits = (uint32_t *)bits;
+                ZeroMemory(glowbits, (size_t)w * h * sizeof(uint32_t));
+            }
+        }
+
         ReleaseDC(hwnd, hdc);
+        startup.Mark("run staging");
 
         InitMatrix(hwnd);
-        QueryPerformanceFrequency(&freq);
+        startup.Mark("matrix");
 
         if (fScreenSaving) SetCursor(NULL);
         return 0;
 
     case WM_SIZE:
-        numcols = (short)LOWORD(lParam) / xChar + 1;
-        numrows = (short)HIWORD(lParam) / yChar + 1;
-
-        if (numrows <= 0 || numrows >= maxrows) numrows = maxrows - 1;
-        if (numcols <= 0 || numcols >= maxcols) numcols = maxcols - 1;
-
-        for (i = numcols; i < maxcols; i++) {
-            matrix[i].started   = false;
-            matrix[i].initcount = jjrand() % 20;
-            matrix[i].blippos   = jjrand() % numrows;
-            for (j = 0; j < numrows; j++) matrix[i].run[j] = -1;
-        }
-        return 0;
-
-    case WM_TIMER:
-        {
-            if (!fScreenSaving) QueryPerformanceCounter(&pc1);
-
-            DecodeMatrix(hwnd);
-
-            if (!fScreenSaving) {
-                QueryPerformanceCounter(&pc2);
-                TCHAR buf[64];
-                median += DWORD(DWORD(freq.QuadPart) / DWORD(pc2.QuadPart - pc1.QuadPart));
-                if (++fpscount == 16) {
-                    wsprintf(buf, _T("%s - %u FPS"), szAppName, median / 16);
-                    SetWindowText(hwnd, buf);
-                    median = 0; fpscount = 0;
-                }
-            }
-        }
+        engine.Resize((short)LOWORD(lParam) / xChar + 1, (short)HIWORD(lParam) / yChar + 1);
+        numcols = engine.NumCols();
+        numrows = engine.NumRows();
         return 0;
 
     case WM_DESTROY:
-        KillTimer(hwnd, 0xdeadbeef);
-
         SelectObject(hdcSymbols, holddc);
         SelectPalette(hdcSymbols, holdpal, FALSE);
         DeleteDC    (hdcSymbols);
         DeleteObject(hSymbolBitmap);
-        DeleteObject(hPalette);
+        DeleteDC    (hdcRun);
+        DeleteObject(hRunBitmap);
+        if (hdcGlow) DeleteDC(hdcGlow);
+        if (hGlowBitmap) DeleteObject(hGlowBitmap);
+        glowbits = 0;
+        if (hPalette) DeleteObject(hPalette);
 
         PostQuitMessage(0);
         return 0;
@@ -536,7 +856,7 @@ static void ReadControlsIntoGlobals(HWND h)
     FontBold          = (IsDlgButtonChecked(h, IDC_FONTBOLD)   == BST_CHECKED);
     RandomizeMessages = (IsDlgButtonChecked(h, IDC_RANDOMMSG)  == BST_CHECKED);
     GetDlgItemText(h, IDC_FONTNAME, szFontName, (int)(sizeof(szFontName)/sizeof(szFontName[0])));
-    ClampSettings();
+    ClampGlobals();
 }
 
 static void WriteGlobalsIntoControls(HWND h)
@@ -706,21 +1026,69 @@ int Normal(int iCmdShow)
     wndclass.hIconSm       = LoadIcon(NULL, IDI_APPLICATION);
 
     RegisterClassEx(&wndclass);
+    startup.Mark("window class");
 
     InitMessage();
+    startup.Mark("messages");
+
+    if (iCmdShow == SW_MAXIMIZE) {
+        // span the virtual desktop; maximizing would only cover the primary monitor
+        hwnd = CreateWindowEx(exStyle, szAppName, szAppName, style,
+                              ScreenSize.left, ScreenSize.top,
+                              ScreenSize.right - ScreenSize.left, ScreenSize.bottom - ScreenSize.top,
+                              NULL, NULL, hInst, NULL);
+        iCmdShow = SW_SHOW;
+    } else {
+        hwnd = CreateWindowEx(exStyle, szAppName, szAppName, style,
+                              CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
+                              NULL, NULL, hInst, NULL);
+    }
 
-    hwnd = CreateWindowEx(exStyle, szAppName, szAppName, style,
-                          CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT,
-                          NULL, NULL, hInst, NULL);
+    startup.Mark("window");
 
     ShowWindow(hwnd, iCmdShow);
     UpdateWindow(hwnd);
+    startup.Mark("show");
+
+    // fixed logical rate (what the old WM_TIMER period was). Each wake-up
+    // runs the steps that are due and presents them as one frame, so a
+    // slow present is caught up in steps instead of slowing the rain. A
+    // wake-up with no step due presents nothing: the grid hasn't changed,
+    // GDI draws straight to the window with no buffer to flip, and the
+    // afterglow fades once per frame, so extra frames would speed it up.
+    // Sleeps are 1ms-granular rather than 15.6ms.
+    SteadyClock    clock;
+    FrameScheduler scheduler(&clock, MatrixSpeed * 10000);
+
+    timeBeginPeriod(1);
+
+    for (;;) {
+        if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) break;
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+            continue;
+        }
 
-    while (GetMessage(&msg, NULL,0,0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+        int steps = scheduler.Due();
+
+        if (steps > 0 && IsWindow(hwnd)) {
+            PresentFrame(hwnd, steps);
+            if (!startup.Finished()) {
+                startup.Mark("first frame");
+                startup.Finish();
+                ReportStartup();
+            }
+            continue;
+        }
+
+        // wait for the next step, or for input
+        DWORD ms = (DWORD)((scheduler.UntilNext() + 999) / 1000);
+        MsgWaitForMultipleObjects(0, NULL, FALSE, ms, QS_ALLINPUT);
     }
 
+    timeEndPeriod(1);
+
     DeInitMessage();
     return (int)msg.wParam;
 }
@@ -6,188 +6,123 @@
 
 
 
-HBITMAP LoadBitmap2(HDC hdc,HINSTANCE hInstance, TCHAR *bmpfile)
+BOOL OpenBmp(HINSTANCE hInstance, const TCHAR *bmpfile, BmpSource *src)
 {
-	HANDLE hFile = INVALID_HANDLE_VALUE, hMap = 0;
-
-	HRSRC hrsrc;
-	HANDLE hResource = NULL;
-	
-	BYTE *pmem;
-	BITMAPFILEHEADER *bfh;
-	
-	BITMAPINFO *bi;
-	BITMAPINFOHEADER *bih;
-	
+	src->hFile = INVALID_HANDLE_VALUE;
+	src->hMap  = 0;
+	src->mem   = 0;
+
 	if(hInstance == 0)
 	{
-		hFile = CreateFile(bmpfile, GENERIC_READ, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, 0);
+		src->hFile = CreateFile(bmpfile, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, 0);
 
-		if(hFile == INVALID_HANDLE_VALUE) return 0;
+		if(src->hFile == INVALID_HANDLE_VALUE) return FALSE;
 
-		hMap = CreateFileMapping(hFile, 0, PAGE_READONLY, 0, 0, 0);
+		LARGE_INTEGER size;
+		if(GetFileSizeEx(src->hFile, &size) && size.QuadPart > 0 && size.QuadPart < 0x7fffffff)
+			src->hMap = CreateFileMapping(src->hFile, 0, PAGE_READONLY, 0, 0, 0);
 
-		if(hMap == NULL)
-		{
-			CloseHandle(hFile);
-			return 0;
-		}
+		if(src->hMap)
+			src->mem = MapViewOfFile(src->hMap, FILE_MAP_READ, 0, 0, 0);
 
-		pmem = (BYTE *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
-		
-		bfh = (BITMAPFILEHEADER *)pmem;
-		bih = (BITMAPINFOHEADER *)(pmem + sizeof BITMAPFILEHEADER);
+		if(src->mem && ParseBmp(src->mem, (size_t)size.QuadPart, src->view))
+			return TRUE;
 	}
 	else
 	{
-		hrsrc = FindResource(hInstance, bmpfile, RT_BITMAP);
-		hResource = LoadResource(hInstance, hrsrc);
-		pmem = (BYTE *)LockResource(hResource);
-	
-		//there is no bitmap file header in a resource
-		bih = (BITMAPINFOHEADER *)pmem;
-	}
-
-	if(!bih) return 0;
-	bi = (BITMAPINFO *)bih;
-
-//	HDC hdc = GetDC(0);
-	//HBITMAP j = CreateDIBitmap(hdc, bih, CBM_INIT, pmem+(bfh->bfOffBits), bi, DIB_RGB_COLORS);
-	
-	HBITMAP j = CreateCompatibleBitmap(hdc, bih->biWidth, bih->biHeight);
-	SetDIBits(hdc, j, 0, bih->biHeight, bi->bmiColors, bi, DIB_RGB_COLORS);
+		HRSRC hrsrc = FindResource(hInstance, bmpfile, RT_BITMAP);
+		HGLOBAL hResource = hrsrc ? LoadResource(hInstance, hrsrc) : 0;
+		void *pmem = hResource ? LockResource(hResource) : 0;
 
-	if(hInstance == 0)
-	{
-		UnmapViewOfFile(pmem);
-		CloseHandle(hMap);
-		CloseHandle(hFile);
-	}
-	else
-	{
-		DeleteObject(hResource);
+		//there is no bitmap file header in a resource
+		if(pmem && ParseDib(pmem, SizeofResource(hInstance, hrsrc), src->view))
+			return TRUE;
 	}
 
-//	ReleaseDC(0, hdc);
-	return j;
+	CloseBmp(src);
+	return FALSE;
 }
 
+void CloseBmp(BmpSource *src)
+{
+	if(src->mem) UnmapViewOfFile(src->mem);
+	if(src->hMap) CloseHandle(src->hMap);
+	if(src->hFile != INVALID_HANDLE_VALUE) CloseHandle(src->hFile);
 
+	src->hFile = INVALID_HANDLE_VALUE;
+	src->hMap  = 0;
+	src->mem   = 0;
+}
 
-
-HBITMAP DIBtoDDB(HDC hdc,void *hDIB)
+HPALETTE CreateBmpPalette(HDC hdc, const BmpView &view)
 {
-	BITMAPINFOHEADER *bih;
-	HBITMAP		     hBitmap;
-	BITMAPINFO		*bi;
-	HPALETTE		hPalette;
-	void *pDIBits;
-	
-	if(hDIB == 0) return 0;
-
-	bih = (BITMAPINFOHEADER *)hDIB;
+	if(view.colors == 0)
+		return CreateHalftonePalette(hdc);
 
-	int nColors = bih->biClrUsed ? bih->biClrUsed : 1 << bih->biBitCount;
+	BYTE buf[sizeof(LOGPALETTE) + sizeof(PALETTEENTRY) * 256];
+	LOGPALETTE *lp = (LOGPALETTE *)buf;
 
-	bi = (BITMAPINFO *)hDIB;
+	lp->palVersion    = 0x300;
+	lp->palNumEntries = (WORD)view.colors;
 
-	if(nColors <= 256)// && GetDeviceCaps(hdc, RASTERCAPS) & RC_PALETTE)
+	for(int i = 0; i < view.colors; i++)
 	{
-		UINT nSize = sizeof(LOGPALETTE) + (sizeof(PALETTEENTRY) * nColors);
-		LOGPALETTE *lp = (LOGPALETTE *)new BYTE[nSize];
-
-		lp->palVersion = 0x300;
-		lp->palNumEntries = nColors;
-
-		for(int i = 0; i < nColors; i++)
-		{
-			lp->palPalEntry[i].peRed   = bi->bmiColors[i].rgbRed;
-			lp->palPalEntry[i].peGreen = bi->bmiColors[i].rgbGreen;
-			lp->palPalEntry[i].peBlue  = bi->bmiColors[i].rgbBlue;
-			lp->palPalEntry[i].peFlags = 0;
-		}
-	
-		hPalette = CreatePalette(lp);
-		delete[] lp;
-
-		SelectPalette(hdc, hPalette, FALSE);
-		RealizePalette(hdc);
+		const BYTE *q = view.palette + i * 4;
+		lp->palPalEntry[i].peRed   = q[2];
+		lp->palPalEntry[i].peGreen = q[1];
+		lp->palPalEntry[i].peBlue  = q[0];
+		lp->palPalEntry[i].peFlags = 0;
 	}
 
-	if(bi->bmiHeader.biBitCount > 8)
-		pDIBits = bi->bmiColors + bi->bmiHeader.biClrUsed + 
-		(bi->bmiHeader.biCompression == BI_BITFIELDS ? 3 : 0);
-	else
-		pDIBits = bi->bmiColors + nColors;
-
-	pDIBits = bi->bmiColors + nColors;
+	return CreatePalette(lp);
+}
 
-	hBitmap = CreateDIBitmap(hdc, bih, CBM_INIT, pDIBits, bi, DIB_RGB_COLORS);
-		
+HBITMAP CreateBmpBitmap(HDC hdc, const BmpView &view)
+{
+	//header and palette are back to back, which is a BITMAPINFO
+	const BITMAPINFO *bi = (const BITMAPINFO *)view.info;
 
-	return hBitmap;
+	return CreateDIBitmap(hdc, &bi->bmiHeader, (LONG)CBM_INIT, view.bits, bi, DIB_RGB_COLORS);
 }
 
-HBITMAP LoadBitmap3(HDC hdc, HINSTANCE hInstance, TCHAR *bmpfile)
+HBITMAP CreateImageBitmap(HDC hdc, const BmpImage &img)
 {
-	HANDLE hFile = INVALID_HANDLE_VALUE;
-	HANDLE hMap = 0;
-
-	HRSRC hrsrc;
-	HANDLE hResource = 0;
-	
-	BYTE *pmem;
-	BITMAPFILEHEADER *bfh;
-	
-	BITMAPINFO *bi;
-	BITMAPINFOHEADER *bih;
-	
-	if(hInstance == 0)
-	{
-		hFile = CreateFile(bmpfile, GENERIC_READ, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_READONLY, 0);
+	if(img.pixels.empty()) return 0;
 
-		if(hFile == 0) return 0;
+	BITMAPINFO bi = { 0 };
+	bi.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
+	bi.bmiHeader.biWidth       = img.width;
+	bi.bmiHeader.biHeight      = -img.height;		//top row first
+	bi.bmiHeader.biPlanes      = 1;
+	bi.bmiHeader.biBitCount    = 32;
+	bi.bmiHeader.biCompression = BI_RGB;
 
-		hMap = CreateFileMapping(hFile, 0, PAGE_READONLY, 0, 0, 0);
+	return CreateDIBitmap(hdc, &bi.bmiHeader, (LONG)CBM_INIT, &img.pixels[0], &bi, DIB_RGB_COLORS);
+}
 
-		if(hMap == 0)
-		{
-			CloseHandle(hFile);
-			return 0;
-		}
+HBITMAP LoadBitmap2(HDC hdc,HINSTANCE hInstance, TCHAR *bmpfile)
+{
+	BmpSource src;
+	if(!OpenBmp(hInstance, bmpfile, &src)) return 0;
 
-		pmem = (BYTE *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
-		
-		bfh = (BITMAPFILEHEADER *)pmem;
-		bih = (BITMAPINFOHEADER *)(pmem + sizeof BITMAPFILEHEADER);
-	}
-	else
-	{
-		hrsrc = FindResource(hInstance, bmpfile, RT_BITMAP);
-		hResource = LoadResource(hInstance, hrsrc);
-		pmem = (BYTE *)LockResource(hResource);
-	
-		//there is no bitmap file header in a resource
-		bih = (BITMAPINFOHEADER *)pmem;
-	}
+	HBITMAP hBitmap = CreateBmpBitmap(hdc, src.view);
+
+	CloseBmp(&src);
+	return hBitmap;
+}
 
-	if(!bih) return 0;
-	bi = (BITMAPINFO *)bih;
+HBITMAP LoadBitmap3(HDC hdc, HINSTANCE hInstance, TCHAR *bmpfile)
+{
+	BmpSource src;
+	if(!OpenBmp(hInstance, bmpfile, &src)) return 0;
 
-	//Load the bitmap here
-	HBITMAP hBitmap = DIBtoDDB(hdc, bih);
-		
-	if(hInstance == 0)
-	{
-		UnmapViewOfFile(pmem);
-		CloseHandle(hMap);
-		CloseHandle(hFile);
-	}
-	else
-	{
-		DeleteObject(hResource);
-	}
+	//select and realize the bitmap's palette before converting
+	HPALETTE hPalette = CreateBmpPalette(hdc, src.view);
+	SelectPalette(hdc, hPalette, FALSE);
+	RealizePalette(hdc);
+
+	HBITMAP hBitmap = CreateBmpBitmap(hdc, src.view);
 
-//	ReleaseDC(0, hdc);
+	CloseBmp(&src);
 	return hBitmap;
 }
@@ -2,6 +2,7 @@
 #define _BITMAP_INCLUDED
 
 #include <windows.h>
+#include "core/bmp.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,4 +15,30 @@ HBITMAP LoadBitmap3(HDC hdc,HINSTANCE hInstance, TCHAR *bmpfile);
 }
 #endif
 
-#endif
\ No newline at end of file
+//
+//	A bitmap opened once, from a file (hInstance == 0: bmpfile is a path,
+//	mapped read-only) or a resource (bmpfile names an RT_BITMAP), and
+//	parsed in place. view points into the mapping or the resource until
+//	CloseBmp.
+//
+struct BmpSource
+{
+	HANDLE  hFile;
+	HANDLE  hMap;
+	void   *mem;		//the view of a mapped file; resources need no unmapping
+	BmpView view;
+};
+
+BOOL OpenBmp(HINSTANCE hInstance, const TCHAR *bmpfile, BmpSource *src);
+void CloseBmp(BmpSource *src);
+
+// the bitmap's own palette, or a halftone one when it has none
+HPALETTE CreateBmpPalette(HDC hdc, const BmpView &view);
+
+// a device-dependent copy of the bitmap, for BitBlt
+HBITMAP CreateBmpBitmap(HDC hdc, const BmpView &view);
+
+// the same from decoded (or generated) 0x00RRGGBB pixels
+HBITMAP CreateImageBitmap(HDC hdc, const BmpImage &img);
+
+#endif
@@ -0,0 +1,353 @@
+#include <string.h>
+#include "afterglow.h"
+#include "drawlist.h"
+#include "aligned.h"
+#include "simd.h"
+#include "threadpool.h"
+
+//
+//	Decay one row of glow: every tile with need set is multiplied by
+//	keep/256, and any gets set for tiles still glowing afterwards. Tiles
+//	are GLOW_TILE bytes, 64-byte aligned. The vector versions widen to
+//	16 bits, multiply, shift back and pack with unsigned saturation.
+//
+static void DecayScalar(uint8_t *row, const uint8_t *need, uint8_t *any, int tiles, int keep)
+{
+	for(int t = 0; t < tiles; t++)
+	{
+		if(!need[t]) continue;
+
+		uint8_t *p = row + t * GLOW_TILE;
+		unsigned on = 0;
+
+		for(int i = 0; i < GLOW_TILE; i++)
+		{
+			p[i] = (uint8_t)(p[i] * keep >> 8);
+			on |= p[i];
+		}
+
+		any[t] |= on != 0;
+	}
+}
+
+#ifdef MATRIX_HAVE_SSE2
+static void DecaySSE2(uint8_t *row, const uint8_t *need, uint8_t *any, int tiles, int keep)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i k    = _mm_set1_epi16((short)keep);
+
+	for(int t = 0; t < tiles; t++)
+	{
+		if(!need[t]) continue;
+
+		__m128i *p  = (__m128i *)(row + t * GLOW_TILE);
+		__m128i  on = zero;
+
+		for(int i = 0; i < GLOW_TILE / 16; i++)
+		{
+			__m128i v  = _mm_load_si128(p + i);
+			__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), k), 8);
+			__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), k), 8);
+
+			v = _mm_packus_epi16(lo, hi);
+			_mm_store_si128(p + i, v);
+			on = _mm_or_si128(on, v);
+		}
+
+		any[t] |= _mm_movemask_epi8(_mm_cmpeq_epi8(on, zero)) != 0xffff;
+	}
+}
+#endif
+
+#ifdef MATRIX_HAVE_AVX2
+MATRIX_TARGET_AVX2 static void DecayAVX2(uint8_t *row, const uint8_t *need, uint8_t *any, int tiles, int keep)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i k    = _mm256_set1_epi16((short)keep);
+
+	for(int t = 0; t < tiles; t++)
+	{
+		if(!need[t]) continue;
+
+		__m256i *p  = (__m256i *)(row + t * GLOW_TILE);
+		__m256i  on = zero;
+
+		//unpack and pack both work within 128-bit lanes, so bytes stay put
+		for(int i = 0; i < GLOW_TILE / 32; i++)
+		{
+			__m256i v  = _mm256_load_si256(p + i);
+			__m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), k), 8);
+			__m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), k), 8);
+
+			v = _mm256_packus_epi16(lo, hi);
+			_mm256_store_si256(p + i, v);
+			on = _mm256_or_si256(on, v);
+		}
+
+		any[t] |= (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(on, zero)) != 0xffffffffu;
+	}
+}
+#endif
+
+// the brighter of each byte, dst and src; cellpitch bytes, a multiple of 16
+static inline void MaxRow(uint8_t *dst, const uint8_t *src, int n)
+{
+#ifdef MATRIX_HAVE_SSE2
+	for(int i = 0; i < n; i += 16)
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(_mm_loadu_si128((const __m128i *)(dst + i)),
+		                                                    _mm_load_si128((const __m128i *)(src + i))));
+#else
+	for(int i = 0; i < n; i++)
+		if(src[i] > dst[i]) dst[i] = src[i];
+#endif
+}
+
+// n pixels of glow to colour; the dark gaps between strokes go 16 at a time
+static inline void ColourRow(uint32_t *dst, const uint8_t *g, int n, const uint32_t *colors)
+{
+	int x = 0;
+
+#ifdef MATRIX_HAVE_SSE2
+	const __m128i zero  = _mm_setzero_si128();
+	const __m128i black = _mm_set1_epi32((int)colors[0]);
+
+	for(; x + 16 <= n; x += 16)
+	{
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(g + x)), zero)) == 0xffff)
+		{
+			for(int i = 0; i < 16; i += 4)
+				_mm_storeu_si128((__m128i *)(dst + x + i), black);
+			continue;
+		}
+
+		for(int i = 0; i < 16; i++)
+			dst[x + i] = colors[g[x + i]];
+	}
+#endif
+	for(; x < n; x++)
+		dst[x] = colors[g[x]];
+}
+
+Afterglow::Afterglow()
+	: glow(0), width(0), height(0), gpitch(0), tiles(0), cells(0), cellw(0), cellh(0), cellpitch(0), cellsize(0), numcells(0),
+	  cols(0), rows(0), keep(0), kernel(SIMD_AUTO), decay(DecayScalar)
+{
+	memset(colors, 0, sizeof(colors));
+}
+
+Afterglow::~Afterglow()
+{
+	Destroy();
+	AlignedFree(cells);
+}
+
+bool Afterglow::SetAtlas(const std::vector<uint8_t> &atlas, int glyphs, int w, int h, const ShadeTable &shades)
+{
+	if(glyphs <= 0 || w <= 0 || h <= 0 || shades.Shades() == 0 ||
+	   atlas.size() < (size_t)glyphs * w * (MATRIX_BLIP + 1) * h)
+		return false;
+
+	//Create sizes everything from the cell size
+	if(w != cellw || h != cellh)
+		Destroy();
+
+	cellw     = w;
+	cellh     = h;
+	cellpitch = (int)AlignUp(w, 16);
+	cellsize  = cellpitch * h;
+	numcells  = glyphs * (MATRIX_BLIP + 1);
+
+	//each glyph/intensity becomes a block of 16-byte rows, zeros past the glyph,
+	//so blending can go a whole vector at a time: max with 0 changes nothing
+	AlignedFree(cells);
+	cells = (uint8_t *)AlignedAlloc((size_t)numcells * cellsize);
+	memset(cells, 0, (size_t)numcells * cellsize);
+
+	int across = glyphs * w;
+
+	for(int sy = 0; sy <= MATRIX_BLIP; sy++)
+		for(int g = 0; g < glyphs; g++)
+		{
+			uint8_t *dst = cells + (size_t)(sy * glyphs + g) * cellsize;
+			for(int y = 0; y < h; y++)
+				memcpy(dst + y * cellpitch, &atlas[(size_t)(sy * h + y) * across + g * w], w);
+		}
+
+	memcpy(colors, shades.GlowColors(), sizeof(colors));
+	return true;
+}
+
+void Afterglow::Create(int w, int h)
+{
+	Destroy();
+
+	if(cellw == 0 || w <= 0 || h <= 0)
+		return;
+
+	width  = w;
+	height = h;
+	cols   = (w + cellw - 1) / cellw;
+	rows   = (h + cellh - 1) / cellh;
+
+	//room for the last cell's padded rows, in whole tiles
+	gpitch = (int)AlignUp((size_t)cols * cellw + cellpitch, GLOW_TILE);
+	tiles  = gpitch / GLOW_TILE;
+
+	size_t bytes = (size_t)gpitch * rows * cellh;
+	glow = (uint8_t *)AlignedAlloc(bytes);
+	memset(glow, 0, bytes);
+
+	target.assign((size_t)cols * rows, GLOW_BLANK);
+	live.assign((size_t)rows * tiles, 0);
+	work.assign((size_t)rows * tiles * 2, 0);
+	span.assign((size_t)rows * 3, 0);
+}
+
+void Afterglow::Destroy()
+{
+	AlignedFree(glow);
+	glow = 0;
+	width = height = gpitch = tiles = 0;
+	cols = rows = 0;
+	target.clear();
+	live.clear();
+	work.clear();
+	span.clear();
+}
+
+void Afterglow::SetKeep(int k)
+{
+	if(k < 0)   k = 0;
+	if(k > 255) k = 255;
+	keep = k;
+}
+
+void Afterglow::Draw(const DrawList &list, uint32_t *pixels, int pitch, ThreadPool *pool)
+{
+	if(glow == 0 || cells == 0)
+		return;
+
+	//the cells as the blit path would leave them, overlays last
+	const DrawCmd  *cmds = list.Commands();
+	const uint16_t *src  = list.Cells();
+
+	for(int i = 0; i < list.Size(); i++)
+	{
+		const DrawCmd &c = cmds[i];
+		if(c.x >= cols) continue;
+
+		for(int k = 0; k < c.count && c.y + k < rows; k++)
+		{
+			int cell = c.op == DRAW_BLIT ? src[c.first + k] : GLOW_BLANK;
+			target[(size_t)(c.y + k) * cols + c.x] = (uint16_t)(cell < numcells ? cell : GLOW_BLANK);
+		}
+	}
+
+	switch(SimdResolve(kernel))
+	{
+#ifdef MATRIX_HAVE_AVX2
+	case SIMD_AVX2: decay = DecayAVX2; break;
+#endif
+#ifdef MATRIX_HAVE_SSE2
+	case SIMD_SSE2: decay = DecaySSE2; break;
+#endif
+	default:        decay = DecayScalar; break;
+	}
+
+	auto band = [&](int b) { DrawBand(b, pixels, pitch); };
+
+	//ParallelFor returns once every band is done, so the frame is complete
+	if(pool == 0 || rows < 2)
+	{
+		for(int b = 0; b < rows; b++) band(b);
+		return;
+	}
+
+	pool->ParallelFor(rows, band);
+}
+
+void Afterglow::DrawBand(int b, uint32_t *pixels, int pitch)
+{
+	uint8_t *need = &work[(size_t)b * tiles * 2];
+	uint8_t *any  = need + tiles;
+	uint8_t *was  = &live[(size_t)b * tiles];
+	const uint16_t *cell = &target[(size_t)b * cols];
+
+	//tiles that are glowing, or about to be
+	memcpy(need, was, tiles);
+	memset(any, 0, tiles);
+
+	for(int x = 0; x < cols; x++)
+		if(cell[x] != GLOW_BLANK)
+		{
+			int t0 = x * cellw / GLOW_TILE, t1 = (x * cellw + cellw - 1) / GLOW_TILE;
+			for(int t = t0; t <= t1; t++) need[t] = any[t] = 1;
+		}
+
+	int *s = &span[(size_t)b * 3];
+	s[0] = s[1] = s[2] = 0;
+
+	int t0 = 0, t1 = tiles;
+	while(t0 < t1 && !need[t0])     t0++;
+	while(t1 > t0 && !need[t1 - 1]) t1--;
+
+	if(t0 == t1)
+		return;
+
+	uint8_t *top = glow + (size_t)b * cellh * gpitch;
+
+	for(int y = 0; y < cellh; y++)
+		decay(top + (size_t)y * gpitch, need, any, tiles, keep);
+
+	for(int x = 0; x < cols; x++)
+		if(cell[x] != GLOW_BLANK)
+		{
+			const uint8_t *src = cells + (size_t)cell[x] * cellsize;
+			uint8_t *dst = top + x * cellw;
+
+			for(int y = 0; y < cellh; y++)
+				MaxRow(dst + (size_t)y * gpitch, src + y * cellpitch, cellpitch);
+		}
+
+	//colour what was worked on, clipped to the framebuffer
+	int y1 = (b + 1) * cellh < height ? cellh : height - b * cellh;
+	int done = 0;
+
+	for(int t = t0; t < t1; t++)
+	{
+		if(!need[t]) continue;
+
+		int x0 = t * GLOW_TILE;
+		int x1 = x0 + GLOW_TILE < width ? x0 + GLOW_TILE : width;
+
+		for(int y = 0; y < y1; y++)
+			if(x0 < x1)
+				ColourRow(pixels + (size_t)(b * cellh + y) * pitch + x0, top + (size_t)y * gpitch + x0, x1 - x0, colors);
+
+		done++;
+	}
+
+	memcpy(was, any, tiles);
+
+	s[0] = t0 * GLOW_TILE;
+	s[1] = t1 * GLOW_TILE < width ? t1 * GLOW_TILE : width;
+	s[2] = done;
+}
+
+bool Afterglow::Changed(int b, int &x0, int &x1) const
+{
+	if(b < 0 || b >= rows || span[(size_t)b * 3 + 2] == 0)
+		return false;
+
+	x0 = span[(size_t)b * 3];
+	x1 = span[(size_t)b * 3 + 1];
+	return x0 < x1;
+}
+
+int Afterglow::Tiles() const
+{
+	int n = 0;
+	for(int b = 0; b < rows; b++)
+		n += span[(size_t)b * 3 + 2];
+	return n;
+}
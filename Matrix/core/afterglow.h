@@ -0,0 +1,93 @@
+#ifndef MATRIX_AFTERGLOW_INC
+#define MATRIX_AFTERGLOW_INC
+
+#include <stdint.h>
+#include <vector>
+#include "theme.h"
+
+#define GLOW_TILE	64			//pixels per tile across: one cache line of glow
+#define GLOW_BLANK	0xffff		//a cell with nothing on it
+
+class DrawList;
+class ThreadPool;
+
+//
+//	Phosphor afterglow for a CPU framebuffer. Instead of a cell snapping
+//	to black or to its next glyph, every pixel keeps a glow (0..255) that
+//	fades from frame to frame:
+//
+//		- the frame's DrawList says what each cell shows now (the same
+//		  cells the blit path would draw, messages included)
+//		- every pixel's glow is multiplied by keep/256
+//		- every cell showing a glyph is max-blended back in from the glow
+//		  atlas (BuildGlowAtlas)
+//		- the glow becomes colour through the theme's shades
+//
+//	Work is split into row bands, one row of cells each, run in parallel
+//	with a pool. A band is cut into GLOW_TILE-pixel tiles, and only tiles
+//	that still glow, or have a glyph on them, are decayed, blended and
+//	coloured; a tile that has faded out is written black once and then
+//	left alone.
+//
+class Afterglow
+{
+public:
+	Afterglow();
+	~Afterglow();
+
+	// glow: glyphs across, one row of cellw x cellh cells per intensity
+	bool SetAtlas(const std::vector<uint8_t> &glow, int glyphs, int cellw, int cellh, const ShadeTable &shades);
+
+	// Size the glow in pixels; everything starts dark
+	void Create(int width, int height);
+	void Destroy();
+
+	// The glow a pixel keeps from one frame to the next, out of 256 (0..255)
+	void SetKeep(int k);
+
+	// Pick the decay implementation (SIMD_AUTO by default)
+	void SetKernel(int level) { kernel = level; }
+
+	// One frame into pixels (0x00RRGGBB, pitch pixels per row, at least
+	// Width() x Height()). Only tiles that changed are written.
+	void Draw(const DrawList &list, uint32_t *pixels, int pitch, ThreadPool *pool = 0);
+
+	// Where the last Draw wrote in band b (pixel rows b * CellHeight()
+	// on): x0 <= x < x1. False if it didn't.
+	bool Changed(int b, int &x0, int &x1) const;
+
+	int  Width()      const { return width; }
+	int  Height()     const { return height; }
+	int  Bands()      const { return rows; }
+	int  CellHeight() const { return cellh; }
+
+	// tiles the last Draw worked on
+	int  Tiles() const;
+
+private:
+	void DrawBand(int b, uint32_t *pixels, int pitch);
+
+	uint8_t *glow;			//gpitch bytes per row, rows * cellh rows
+	int width, height, gpitch;
+	int tiles;				//per band, gpitch / GLOW_TILE
+
+	uint8_t *cells;			//the glow atlas, one block per cell number
+	int cellw, cellh;
+	int cellpitch;			//bytes per block row, zero padded to 16
+	int cellsize;
+	int numcells;
+
+	std::vector<uint16_t> target;	//cols * rows cell numbers, or GLOW_BLANK
+	int cols, rows;
+
+	std::vector<uint8_t> live;		//per band and tile: glowing after the last Draw
+	std::vector<uint8_t> work;		//per band, two per tile: scratch for Draw
+	std::vector<int>     span;		//per band: x0, x1, tiles done
+
+	uint32_t colors[256];
+	int keep;
+	int kernel;
+	void (*decay)(uint8_t *row, const uint8_t *need, uint8_t *any, int tiles, int keep);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MATRIX_ALIGNED_INC
+#define MATRIX_ALIGNED_INC
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MATRIX_CACHELINE 64
+
+//
+//	Over-allocate and stash the original pointer just below the aligned
+//	block, so it works the same with every CRT (no aligned_alloc on MSVC).
+//	align must be a power of two.
+//
+inline void *AlignedAlloc(size_t size, size_t align = MATRIX_CACHELINE)
+{
+	void *raw = malloc(size + align + sizeof(void *));
+	if(raw == 0) return 0;
+
+	uintptr_t p = ((uintptr_t)raw + sizeof(void *) + align - 1) & ~(uintptr_t)(align - 1);
+	((void **)p)[-1] = raw;
+	return (void *)p;
+}
+
+inline void AlignedFree(void *p)
+{
+	if(p) free(((void **)p)[-1]);
+}
+
+// round n up to a multiple of align (a power of two)
+inline size_t AlignUp(size_t n, size_t align = MATRIX_CACHELINE)
+{
+	return (n + align - 1) & ~(align - 1);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#include "bitmatrix.h"
+
+void BitMatrix::Create(int w, int h)
+{
+	width  = w;
+	height = h;
+	words  = BitWords(w);
+	bits.assign((size_t)words * h, 0);
+}
+
+void BitMatrix::Clear()
+{
+	bits.assign(bits.size(), 0);
+}
+
+int BitMatrix::Count() const
+{
+	int n = 0;
+	for(size_t i = 0; i < bits.size(); i++)
+		n += Popcount64(bits[i]);
+	return n;
+}
+
+int BitMatrix::CountAnd(const BitMatrix &a, const BitMatrix &b)
+{
+	int n = 0;
+	for(size_t i = 0; i < a.bits.size(); i++)
+		n += Popcount64(a.bits[i] & b.bits[i]);
+	return n;
+}
@@ -0,0 +1,46 @@
+#ifndef MATRIX_BITMATRIX_INC
+#define MATRIX_BITMATRIX_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "bits.h"
+
+//
+//	A 2D mask packed as rows of 64-bit words: bit x of row y is cell (x,y).
+//	Clearing, combining and counting go a word (64 cells) at a time.
+//
+class BitMatrix
+{
+public:
+	BitMatrix() : width(0), height(0), words(0) {}
+	BitMatrix(int w, int h) { Create(w, h); }
+
+	// all clear
+	void Create(int w, int h);
+	void Clear();
+
+	int  Width()  const { return width; }
+	int  Height() const { return height; }
+	int  Words()  const { return words; }		//uint64s per row
+
+	bool Test(int x, int y) const { return TestBit(Row(y), x); }
+	void Set(int x, int y)        { SetBit(Row(y), x); }
+	void Reset(int x, int y)      { Row(y)[x >> 6] &= ~((uint64_t)1 << (x & 63)); }
+
+	uint64_t       *Row(int y)       { return &bits[(size_t)y * words]; }
+	const uint64_t *Row(int y) const { return &bits[(size_t)y * words]; }
+
+	// cells set
+	int  Count() const;
+
+	// cells set in both (same size)
+	static int CountAnd(const BitMatrix &a, const BitMatrix &b);
+
+private:
+	int width, height;
+	int words;
+	std::vector<uint64_t> bits;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef MATRIX_BITS_INC
+#define MATRIX_BITS_INC
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//
+//	Small helpers for packed 64-bit bitsets
+//
+
+// index of the lowest set bit; n must be non-zero
+inline int Ctz64(uint64_t n)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long i;
+	_BitScanForward64(&i, n);
+	return (int)i;
+#elif defined(_MSC_VER)
+	unsigned long i;
+	if(_BitScanForward(&i, (unsigned long)n)) return (int)i;
+	_BitScanForward(&i, (unsigned long)(n >> 32));
+	return (int)i + 32;
+#else
+	return __builtin_ctzll(n);
+#endif
+}
+
+inline int Ctz32(uint32_t n)
+{
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, n);
+	return (int)i;
+#else
+	return __builtin_ctz(n);
+#endif
+}
+
+inline int Popcount64(uint64_t n)
+{
+#if defined(_MSC_VER)
+	//no POPCNT without checking the CPU first, so count in registers
+	n = n - ((n >> 1) & 0x5555555555555555ull);
+	n = (n & 0x3333333333333333ull) + ((n >> 2) & 0x3333333333333333ull);
+	n = (n + (n >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (int)((n * 0x0101010101010101ull) >> 56);
+#else
+	return __builtin_popcountll(n);
+#endif
+}
+
+inline int BitWords(int nbits)
+{
+	return (nbits + 63) >> 6;
+}
+
+inline void SetBit(uint64_t *words, int i)
+{
+	words[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+inline bool TestBit(const uint64_t *words, int i)
+{
+	return (words[i >> 6] >> (i & 63)) & 1;
+}
+
+// first set bit at or after position i, or nbits if there is none
+inline int NextSetBit(const uint64_t *words, int nbits, int i)
+{
+	if(i >= nbits) return nbits;
+
+	int w = i >> 6;
+	uint64_t m = words[w] & (~(uint64_t)0 << (i & 63));
+
+	for(;;)
+	{
+		if(m) { i = (w << 6) + Ctz64(m); return i < nbits ? i : nbits; }
+		if(++w >= BitWords(nbits)) return nbits;
+		m = words[w];
+	}
+}
+
+#endif
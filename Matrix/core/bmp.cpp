@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+#include "bmp.h"
+
+#define BMP_MAXSIDE	65536		//pixels across or down; rejected before any size is worked out
+
+#define BMP_RGB			0			//biCompression
+#define BMP_BITFIELDS	3
+
+static uint32_t Get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t Get32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+// lowest set bit of m, m != 0
+static int Shift(uint32_t m)
+{
+	int n = 0;
+	for(; !(m & 1); m >>= 1) n++;
+	return n;
+}
+
+// a channel mask has to be a single run of bits
+static bool OneRun(uint32_t m)
+{
+	if(m == 0) return false;
+	m >>= Shift(m);
+	return (m & (m + 1)) == 0;
+}
+
+// the info header at dib, with bits at offset bits from base (0 for a packed DIB)
+static bool ParseInfo(const uint8_t *base, size_t size, size_t dib, size_t bits, BmpView &view)
+{
+	if(dib > size || size - dib < 40)
+		return false;
+
+	const uint8_t *bi = base + dib;
+	uint32_t hdrsize = Get32(bi);
+	int      width   = (int)Get32(bi + 4);
+	int      height  = (int)Get32(bi + 8);
+	int      bpp     = (int)Get16(bi + 14);
+	uint32_t compr   = Get32(bi + 16);
+	uint32_t used    = Get32(bi + 32);
+
+	//-INT_MIN doesn't fit
+	if(height < -BMP_MAXSIDE || height > BMP_MAXSIDE || width <= 0 || width > BMP_MAXSIDE)
+		return false;
+
+	bool topdown = height < 0;
+	if(topdown) height = -height;
+
+	if(hdrsize < 40 || hdrsize > size - dib || height == 0)
+		return false;
+	if(bpp != 1 && bpp != 4 && bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32)
+		return false;
+
+	bool fields = compr == BMP_BITFIELDS && (bpp == 16 || bpp == 32);
+	if(compr != BMP_RGB && !fields)
+		return false;
+
+	//the masks end the header from V2 on, and follow a plain 40-byte one
+	uint64_t palstart = (uint64_t)dib + hdrsize;
+	if(fields)
+	{
+		if(hdrsize == 40)
+			palstart += 12;
+		else if(hdrsize < 52)
+			return false;
+
+		if(palstart > size)
+			return false;
+
+		view.masks[0] = Get32(bi + 40);
+		view.masks[1] = Get32(bi + 44);
+		view.masks[2] = Get32(bi + 48);
+
+		if(!OneRun(view.masks[0]) || !OneRun(view.masks[1]) || !OneRun(view.masks[2]))
+			return false;
+	}
+	else if(bpp == 16)
+	{
+		view.masks[0] = 0x7c00;		//5-5-5
+		view.masks[1] = 0x03e0;
+		view.masks[2] = 0x001f;
+	}
+	else
+	{
+		view.masks[0] = 0xff0000;
+		view.masks[1] = 0x00ff00;
+		view.masks[2] = 0x0000ff;
+	}
+
+	//RGBQUADs after that; only 8 bpp and below use them
+	int colors = 0;
+	if(bpp <= 8)
+		colors = used && used < (1u << bpp) ? (int)used : 1 << bpp;
+
+	//sizes in 64 bits, so nothing a header says can wrap them on 32-bit
+	uint64_t palend = palstart + (uint64_t)colors * 4;
+	if(palend > size)
+		return false;
+
+	uint64_t start = bits;
+	if(start == 0)
+		start = palstart + (uint64_t)(used && bpp > 8 ? used : colors) * 4;
+
+	uint64_t pitch = (((uint64_t)width * bpp + 31) / 32) * 4;
+	if(start < palend || start > size || pitch * (uint64_t)height > size - start)
+		return false;
+
+	bits = (size_t)start;
+
+	view.info    = bi;
+	view.palette = colors ? base + (size_t)palstart : 0;
+	view.bits    = base + bits;
+	view.width   = width;
+	view.height  = height;
+	view.bpp     = bpp;
+	view.colors  = colors;
+	view.pitch   = (size_t)pitch;
+	view.topdown = topdown;
+	return true;
+}
+
+bool ParseBmp(const void *data, size_t size, BmpView &view)
+{
+	const uint8_t *file = (const uint8_t *)data;
+
+	if(size < 14 || file[0] != 'B' || file[1] != 'M')
+		return false;
+
+	uint32_t bits = Get32(file + 10);
+	return bits != 0 && ParseInfo(file, size, 14, bits, view);
+}
+
+bool ParseDib(const void *data, size_t size, BmpView &view)
+{
+	return ParseInfo((const uint8_t *)data, size, 0, 0, view);
+}
+
+// one channel of a 16 or 32 bpp pixel, out of 255
+struct Channel
+{
+	int      shift;
+	uint32_t top;		//the channel's largest value, after shift
+
+	// a run of more than 8 bits keeps its top 8
+	void Set(uint32_t mask)
+	{
+		shift = Shift(mask);
+		top   = mask >> shift;
+		for(; top > 0xff; top >>= 1) shift++;
+	}
+
+	uint32_t Get(uint32_t p) const
+	{
+		uint32_t c = (p >> shift) & top;
+		return top == 0xff ? c : (c * 255 + top / 2) / top;
+	}
+};
+
+void DecodeView(const BmpView &view, BmpImage &img)
+{
+	int width  = view.width;
+	int height = view.height;
+
+	img.width  = width;
+	img.height = height;
+	img.colors = view.colors;
+	memset(img.palette, 0, sizeof(img.palette));
+	img.pixels.resize((size_t)width * height);
+	img.index.clear();
+
+	for(int i = 0; i < view.colors; i++)
+		img.palette[i] = view.Color(i);
+
+	if(view.bpp <= 8)
+		img.index.resize((size_t)width * height);
+
+	Channel rgb[3];
+	for(int c = 0; c < 3; c++)
+		rgb[c].Set(view.masks[c]);
+
+	//plain 0x00RRGGBB needs no unpacking
+	bool xrgb = view.bpp == 32 && view.masks[0] == 0xff0000 && view.masks[1] == 0xff00 && view.masks[2] == 0xff;
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint8_t *src = view.Row(y);
+		uint32_t *dst = &img.pixels[(size_t)y * width];
+		uint8_t  *idx = view.bpp <= 8 ? &img.index[(size_t)y * width] : 0;
+
+		switch(view.bpp)
+		{
+		case 1:
+			for(int x = 0; x < width; x++) idx[x] = (src[x >> 3] >> (7 - (x & 7))) & 1;
+			break;
+		case 4:
+			for(int x = 0; x < width; x++) idx[x] = (src[x >> 1] >> (x & 1 ? 0 : 4)) & 15;
+			break;
+		case 8:
+			memcpy(idx, src, width);
+			break;
+		case 16:
+			for(int x = 0; x < width; x++)
+			{
+				uint32_t p = Get16(src + x*2);
+				dst[x] = rgb[0].Get(p) << 16 | rgb[1].Get(p) << 8 | rgb[2].Get(p);
+			}
+			break;
+		case 24:
+			for(int x = 0; x < width; x++) dst[x] = (src[x*3+2] << 16) | (src[x*3+1] << 8) | src[x*3];
+			break;
+		case 32:
+			if(xrgb)
+			{
+				for(int x = 0; x < width; x++) dst[x] = Get32(src + x*4) & 0xffffff;
+				break;
+			}
+			for(int x = 0; x < width; x++)
+			{
+				uint32_t p = Get32(src + x*4);
+				dst[x] = rgb[0].Get(p) << 16 | rgb[1].Get(p) << 8 | rgb[2].Get(p);
+			}
+			break;
+		}
+
+		if(idx)
+			for(int x = 0; x < width; x++) dst[x] = img.palette[idx[x]];
+	}
+}
+
+bool DecodeBmp(const void *data, size_t size, BmpImage &img)
+{
+	BmpView view;
+	if(!ParseBmp(data, size, view))
+		return false;
+
+	DecodeView(view, img);
+	return true;
+}
+
+bool LoadBmp(const char *path, BmpImage &img)
+{
+	FILE *fp = fopen(path, "rb");
+	if(fp == 0) return false;
+
+	std::vector<uint8_t> data;
+	uint8_t buf[65536];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(fp);
+
+	return !data.empty() && DecodeBmp(&data[0], data.size(), img);
+}
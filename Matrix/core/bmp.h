@@ -0,0 +1,80 @@
+#ifndef MATRIX_BMP_INC
+#define MATRIX_BMP_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//
+//	A decoded Windows bitmap, without going through GDI. Handles what
+//	matrix.bmp and user glyph sets come as, bottom-up or top-down:
+//	uncompressed 1, 4, 8, 16, 24 and 32 bpp, and 16 and 32 bpp with
+//	BI_BITFIELDS channel masks. Parsing is shared with BmpView below;
+//	this is the copy for code that wants plain pixels.
+//
+//	Pixels are 0x00RRGGBB, top row first. For 1, 4 and 8 bpp files the
+//	palette is kept too (0x00RRGGBB, colors entries) and index holds the
+//	raw indices, one byte each.
+//
+struct BmpImage
+{
+	int width, height;
+	std::vector<uint32_t> pixels;
+	std::vector<uint8_t>  index;
+	uint32_t palette[256];
+	int colors;
+};
+
+//
+//	A parsed bitmap that points into the caller's memory instead of
+//	copying it: a mapped file or a locked resource stays where it is, and
+//	the header, palette and rows are found once and handed out from there.
+//	The memory must outlive the view.
+//
+//	info is the BITMAPINFOHEADER, and with the palette straight after it
+//	is what GDI takes as a BITMAPINFO. Palette entries are RGBQUADs.
+//
+struct BmpView
+{
+	const uint8_t *info;
+	const uint8_t *palette;		//colors RGBQUADs, 0 above 8 bpp
+	uint32_t masks[3];			//red, green and blue bits of a 16 or 32 bpp pixel
+	const uint8_t *bits;		//first row as stored
+	int    width, height;
+	int    bpp;
+	int    colors;
+	size_t pitch;			//bytes per row, padded to 4
+	bool   topdown;
+
+	// row y counted from the top, whichever way up it is stored
+	const uint8_t *Row(int y) const
+	{
+		return bits + (size_t)(topdown ? y : height - 1 - y) * pitch;
+	}
+
+	// palette entry i as 0x00RRGGBB
+	uint32_t Color(int i) const
+	{
+		const uint8_t *q = palette + i * 4;
+		return (q[2] << 16) | (q[1] << 8) | q[0];
+	}
+};
+
+//
+//	Parse a .bmp file (starting with BITMAPFILEHEADER) or a packed DIB (a
+//	resource: info header, palette and rows back to back). Both check
+//	that everything lies inside size bytes; false for anything else,
+//	including RLE, JPEG and PNG bitmaps, masks that aren't one run of
+//	bits each, and depths other than those above.
+//
+bool ParseBmp(const void *data, size_t size, BmpView &view);
+bool ParseDib(const void *data, size_t size, BmpView &view);
+
+// expand a view into img
+void DecodeView(const BmpView &view, BmpImage &img);
+
+// false if the data isn't a bitmap we can read
+bool DecodeBmp(const void *data, size_t size, BmpImage &img);
+bool LoadBmp(const char *path, BmpImage &img);
+
+#endif
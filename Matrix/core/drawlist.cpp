@@ -0,0 +1,54 @@
+#include "drawlist.h"
+#include "engine.h"
+
+// append a cell, extending the last command (if it's at or after from) when it continues it
+void DrawList::Add(int op, int x, int y, int cell, int from)
+{
+	dirty++;
+
+	if(op == DRAW_BLIT)
+		cells.push_back((uint16_t)cell);
+
+	if((int)cmds.size() > from)
+	{
+		DrawCmd &run = cmds.back();
+		if(run.op == op && run.x == x && run.y + run.count == y)
+		{
+			run.count++;
+			return;
+		}
+	}
+
+	DrawCmd c = { op, x, y, 1, op == DRAW_BLIT ? (int)cells.size() - 1 : 0 };
+	cmds.push_back(c);
+
+	if(op == DRAW_FILL) fills++;
+}
+
+void DrawList::Build(const MatrixEngine &engine)
+{
+	cmds.clear();
+	cells.clear();
+	fills = 0;
+	dirty = 0;
+
+	int numcols = engine.NumCols();
+	int numrows = engine.NumRows();
+	int glyphs  = engine.NumGlyphs();
+
+	for(int x = engine.NextDirtyColumn(0); x < numcols; x = engine.NextDirtyColumn(x + 1))
+		for(int y = engine.NextDirtyRow(x, 0); y < numrows; y = engine.NextDirtyRow(x, y + 1))
+		{
+			int in = engine.Intensity(x, y);
+
+			if(in < 0) Add(DRAW_FILL, x, y, 0, 0);
+			else       Add(DRAW_BLIT, x, y, in * glyphs + engine.Glyph(x, y), 0);
+		}
+
+	base = (int)cmds.size();
+}
+
+void DrawList::Overlay(int x, int y, int cell)
+{
+	Add(DRAW_BLIT, x, y, cell, base);
+}
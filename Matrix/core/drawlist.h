@@ -0,0 +1,67 @@
+#ifndef MATRIX_DRAWLIST_INC
+#define MATRIX_DRAWLIST_INC
+
+#include <stdint.h>
+#include <vector>
+
+class MatrixEngine;
+
+#define DRAW_FILL	0		//clear count cells from (x, y) down
+#define DRAW_BLIT	1		//draw count glyphs from (x, y) down
+
+struct DrawCmd
+{
+	int op;
+	int x, y;				//top cell
+	int count;				//cells down the column
+	int first;				//DRAW_BLIT: index of the first one in DrawList::Cells()
+};
+
+//
+//	One frame's drawing, worked out before anything touches the device.
+//	The dirty cells are walked a column at a time and vertically adjacent
+//	cells of the same kind are merged: a run of blanks becomes one fill
+//	and a run of glyphs one blit command, so a renderer can clear the run
+//	in one call and draw the glyphs through one staging copy.
+//
+//	Glyph cells are atlas cell numbers, intensity * NumGlyphs() + glyph (the
+//	engine's glyph count), with the blip as intensity MATRIX_BLIP.
+//
+//	Overlays (the message glyphs) go after the rain, coalesced the same
+//	way. Both parts are in column order, so a renderer can split the frame
+//	into column bands and find each band's commands by binary search.
+//
+class DrawList
+{
+public:
+	DrawList() : fills(0), dirty(0), base(0) {}
+
+	// from the engine's dirty cells (which are left for the caller to clear)
+	void Build(const MatrixEngine &engine);
+
+	// a glyph drawn over the rain; call after Build, in column order
+	void Overlay(int x, int y, int cell);
+
+	// commands [0, Base()) are the rain, [Base(), Size()) the overlays
+	int  Size()  const { return (int)cmds.size(); }
+	int  Base()  const { return base; }
+	const DrawCmd *Commands() const { return cmds.empty() ? 0 : &cmds[0]; }
+	const DrawCmd &operator[](int i) const { return cmds[i]; }
+	const uint16_t *Cells() const { return cells.empty() ? 0 : &cells[0]; }
+
+	// what this frame costs: commands issued against cells drawn one by one
+	int  Fills() const { return fills; }
+	int  Blits() const { return (int)cmds.size() - fills; }
+	int  DirtyCells() const { return dirty; }
+
+private:
+	void Add(int op, int x, int y, int cell, int from);
+
+	std::vector<DrawCmd>  cmds;
+	std::vector<uint16_t> cells;
+	int fills;
+	int dirty;
+	int base;
+};
+
+#endif
@@ -0,0 +1,387 @@
+#include <string.h>
+#include <new>
+#include "engine.h"
+#include "aligned.h"
+#include "bits.h"
+#include "kernel.h"
+#include "rng.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#define STRIP 64				//columns per work item; a cache line of each byte row
+
+#define EVENT_START 0			//column's initcount has run out
+#define EVENT_FLIP  1			//column's statecount has run out
+#define NEVER 0xffffffffu		//no event pending
+
+MatrixEngine::MatrixEngine()
+	: arena(0), glyph(0), intensity(0), dirty(0), dirtysum(0),
+	  state(0), statecount(0), initcount(0), blippos(0), bliplen(0), started(0), rng(0),
+	  startat(0), flipat(0), running(0), tick(0),
+	  active(0), laneold(0), laneskip(0), bright(0), insert(0), words(0),
+	  maxcols(0), maxrows(0), numcols(0), numrows(0), runlen(0), stride(0), density(DENSITY_MIN), numglyphs(MATRIX_NUMGLYPHS), kernel(SIMD_AUTO), pool(0)
+{
+}
+
+MatrixEngine::~MatrixEngine()
+{
+	Destroy();
+	delete pool;
+}
+
+void MatrixEngine::SetThreads(int threads)
+{
+	delete pool;
+	pool = 0;
+
+	if(threads != 1)
+		pool = new ThreadPool(threads);
+}
+
+int MatrixEngine::Threads() const
+{
+	return pool ? pool->Threads() : 1;
+}
+
+void MatrixEngine::Create(int cols, int rows, int dens, uint64_t seed)
+{
+	Destroy();
+
+	maxcols = cols;
+	maxrows = rows;
+	density = dens;
+	numcols = 0;
+	numrows = 0;
+
+	runlen = maxrows + 1;			//1 for luck
+	stride = (int)AlignUp(maxcols);
+
+	//space for overflow by blips (they mark up to 9 rows past blippos)
+	size_t cells   = (size_t)(runlen + 10) * stride;
+	size_t scalars = AlignUp(stride * sizeof(int));
+
+	size_t lanes   = AlignUp(stride);
+
+	words = BitWords(runlen + 10);
+	size_t bitbytes = AlignUp((size_t)stride * words * sizeof(uint64_t));
+
+	size_t glyphbytes = AlignUp(cells * sizeof(unsigned short));
+	size_t cellbytes  = AlignUp(cells);
+
+	//one bit per column, one word per strip
+	size_t runbytes = AlignUp((size_t)(stride / STRIP) * sizeof(uint64_t));
+
+	unsigned char *p = (unsigned char *)AlignedAlloc(glyphbytes + cellbytes + 7 * scalars + 4 * lanes + sizeof(Rng) * lanes + 3 * bitbytes + 2 * runbytes);
+	arena = p;
+
+	glyph      = (unsigned short *)p;	p += glyphbytes;
+	intensity  = (signed char *)p;		p += cellbytes;
+	state      = (int *)p;				p += scalars;
+	statecount = (int *)p;				p += scalars;
+	initcount  = (int *)p;				p += scalars;
+	blippos    = (int *)p;				p += scalars;
+	bliplen    = (int *)p;				p += scalars;
+	startat    = (uint32_t *)p;		p += scalars;
+	flipat     = (uint32_t *)p;		p += scalars;
+	started    = p;					p += lanes;
+	active     = p;					p += lanes;
+	laneold    = (signed char *)p;	p += lanes;
+	laneskip   = p;					p += lanes;
+	rng        = (Rng *)p;			p += sizeof(Rng) * lanes;
+	bright     = (uint64_t *)p;		p += bitbytes;
+	insert     = (uint64_t *)p;		p += bitbytes;
+	dirty      = (uint64_t *)p;		p += bitbytes;
+	dirtysum   = (uint64_t *)p;		p += runbytes;
+	running    = (uint64_t *)p;
+
+	tick = 0;
+	wheel.Clear();
+
+	memset(active, 0, lanes);
+	memset(laneskip, 0, lanes);
+	memset(running, 0, runbytes);
+	memset(glyph, 0, cells * sizeof(unsigned short));
+	memset(intensity, -1, cells);
+	memset(dirty, 0, bitbytes);
+	memset(dirtysum, 0, runbytes);
+
+	for (int x = 0; x < maxcols; x++) {
+		new (&rng[x]) Rng(seed, (uint32_t)x);
+		InitColumn(x);
+	}
+}
+
+void MatrixEngine::Destroy()
+{
+	AlignedFree(arena);
+	arena = 0;
+	glyph = 0; intensity = 0; dirty = 0; dirtysum = 0;
+	state = statecount = initcount = blippos = bliplen = 0;
+	started = 0; rng = 0;
+	startat = flipat = 0; running = 0; tick = 0;
+	active = 0; laneold = 0; laneskip = 0;
+	bright = 0; insert = 0; words = 0;
+	maxcols = maxrows = numcols = numrows = runlen = stride = 0;
+}
+
+void MatrixEngine::InitColumn(int x)
+{
+	state[x] = rng[x].Below(2);
+	statecount[x] = rng[x].Below(20) + 3;
+
+	initcount[x] = rng[x].Below(maxcols);		//count before we are allowed to start
+	started[x] = false;
+	startat[x] = NEVER;
+	flipat[x] = NEVER;
+
+	blippos[x] = 0;
+	bliplen[x] = rng[x].Below(50) + numrows;
+}
+
+//
+//	The per-column half of the old ScrollDown: everything that draws a
+//	random number. ScrollKernel has already done the transitions for the
+//	whole grid and left the new digits in the insert bitset.
+//
+void MatrixEngine::ScrollDown(int x)
+{
+	const uint64_t *ins = insert + (size_t)x * words;
+
+	for (int i = NextSetBit(ins, numrows, 0); i < numrows; i = NextSetBit(ins, numrows, i + 1))
+		glyph[i * stride + x] = (unsigned short)rng[x].Below(numglyphs);
+
+	MarkBlip(x);
+
+	blippos[x] += 2;
+
+	if (blippos[x] >= bliplen[x]) {
+		bliplen[x] = numrows + rng[x].Below(50);
+		blippos[x] = 0;
+	}
+
+	MarkBlip(x);
+}
+
+void MatrixEngine::MarkBlip(int x)
+{
+	int b = blippos[x];
+
+	if (b >= 0 && b < runlen) {
+		uint64_t *up = dirty + (size_t)x * words;
+		SetBit(up, b);
+		SetBit(up, b + 1);
+		SetBit(up, b + 8);
+		SetBit(up, b + 9);
+		dirtysum[x / STRIP] |= (uint64_t)1 << (x % STRIP);
+	}
+}
+
+//
+//	Give some of the bright digits a new glyph. This works from the cells
+//	that were bright before this tick's scroll, as the original did. The
+//	original's scroll then wiped the dirty flags it set, and columns that
+//	haven't started are blank, so nothing is marked here.
+//
+void MatrixEngine::Randomise(int x)
+{
+	const uint64_t *lit = bright + (size_t)x * words;
+
+	int p = 0;
+	for (int i = 1; i < 20; i++) {
+		p = NextSetBit(lit, numrows, p);
+		if (p >= numrows) break;
+		glyph[p * stride + x] = (unsigned short)rng[x].Below(numglyphs);
+		p += rng[x].Below(10);
+	}
+}
+
+void MatrixEngine::SetGlyphs(int count)
+{
+	if (count < 1) count = 1;
+	if (count > MATRIX_MAXGLYPHS) count = MATRIX_MAXGLYPHS;
+
+	if (count < numglyphs && glyph) {
+		size_t cells = (size_t)(runlen + 10) * stride;
+		for (size_t i = 0; i < cells; i++)
+			glyph[i] = (unsigned short)(glyph[i] % count);
+	}
+
+	numglyphs = count;
+}
+
+void MatrixEngine::Resize(int cols, int rows)
+{
+	numcols = cols;
+	numrows = rows;
+
+	if (numrows <= 0 || numrows >= maxrows) numrows = maxrows - 1;
+	if (numcols <= 0 || numcols >= maxcols) numcols = maxcols - 1;
+
+	for (int x = numcols; x < maxcols; x++) {
+		if (started[x]) Pause(x);
+		started[x]   = false;
+		startat[x]   = NEVER;
+		initcount[x] = rng[x].Below(20);
+		blippos[x]   = rng[x].Below(numrows);
+		for (int y = 0; y < numrows; y++) intensity[y * stride + x] = -1;
+	}
+
+	//columns coming into view start counting down their initcount now
+	for (int x = 0; x < numcols; x++) {
+		if (!started[x] && startat[x] == NEVER) {
+			startat[x] = tick + 1 + (initcount[x] > 1 ? initcount[x] : 1);
+			wheel.Add(startat[x], (uint32_t)x << 1 | EVENT_START);
+		}
+	}
+}
+
+//
+//	Column events. Each fires at the start of the tick it is due on;
+//	stale events (the column was reset or rescheduled since) no longer
+//	match startat/flipat and are dropped.
+//
+//	A column that ran out of initcount on tick t scrolled for the first
+//	time on t+1, and one that ran out of statecount on tick t inserted
+//	with its new state from t+1, so that is when the events are due.
+//
+void MatrixEngine::Start(int x)
+{
+	if (startat[x] != tick) return;
+
+	startat[x] = NEVER;
+	started[x] = true;
+	active[x]  = 0xff;
+	running[x / STRIP] |= (uint64_t)1 << (x % STRIP);
+
+	flipat[x] = tick + statecount[x];
+	wheel.Add(flipat[x], (uint32_t)x << 1 | EVENT_FLIP);
+}
+
+void MatrixEngine::Flip(int x)
+{
+	if (flipat[x] != tick) return;
+
+	ToggleState(x);
+
+	flipat[x] = tick + statecount[x];
+	wheel.Add(flipat[x], (uint32_t)x << 1 | EVENT_FLIP);
+}
+
+void MatrixEngine::ToggleState(int x)
+{
+	state[x] ^= 1;
+	if (state[x] == 0)  statecount[x] = rng[x].Below(DENSITY_MAX + 1 - density) + (DENSITY_MIN * 2);
+	else                statecount[x] = rng[x].Below(3 * density / 2) + DENSITY_MIN;
+}
+
+// stop a running column, keeping what is left of its statecount for when it restarts
+void MatrixEngine::Pause(int x)
+{
+	if (flipat[x] <= tick + 1)
+		ToggleState(x);			//ran out on the last tick, just not applied yet
+	else
+		statecount[x] = (int)(flipat[x] - tick - 1);
+
+	flipat[x] = NEVER;
+	active[x] = 0;
+	running[x / STRIP] &= ~((uint64_t)1 << (x % STRIP));
+}
+
+void MatrixEngine::Step()
+{
+	tick++;
+
+	due.clear();
+	wheel.Pop(tick, due);
+
+	for (size_t i = 0; i < due.size(); i++) {
+		int x = (int)(due[i] >> 1);
+		if (due[i] & EVENT_FLIP) Flip(x);
+		else                     Start(x);
+	}
+
+	//strips with nothing running have nothing to do
+	work.clear();
+	int strips = (numcols + STRIP - 1) / STRIP;
+	for (int i = 0; i < strips; i++)
+		if (running[i]) work.push_back(i);
+
+	auto strip = [this](int i) {
+		int x0 = work[i] * STRIP;
+		StepColumns(x0, x0 + STRIP < numcols ? x0 + STRIP : numcols);
+	};
+
+	if (pool == 0 || work.size() < 2) {
+		for (int i = 0; i < (int)work.size(); i++) strip(i);
+		return;
+	}
+
+	pool->ParallelFor((int)work.size(), strip);
+}
+
+//
+//	Step columns [x0, x1). x0 is a multiple of STRIP, so the strip starts
+//	on a cache line in every row and strips never share one.
+//
+void MatrixEngine::StepColumns(int x0, int x1)
+{
+	uint64_t run = running[x0 / STRIP];
+
+	//idle lanes go through the kernel masked off, with skip left at 0
+	for (uint64_t m = run; m; m &= m - 1) {
+		int x = x0 + Ctz64(m);
+		laneold[x]  = (signed char)(state[x] ? MATRIX_BRIGHT : -1);
+		laneskip[x] = 0;
+	}
+
+	memset(bright + (size_t)x0 * words, 0, (size_t)(x1 - x0) * words * sizeof(uint64_t));
+	memset(insert + (size_t)x0 * words, 0, (size_t)(x1 - x0) * words * sizeof(uint64_t));
+
+	ScrollArgs a;
+	a.intensity = intensity + x0;
+	a.stride    = stride;
+	a.numcols   = x1 - x0;
+	a.numrows   = numrows;
+	a.active    = active + x0;
+	a.old       = laneold + x0;
+	a.skip      = laneskip + x0;
+	a.bright    = bright + (size_t)x0 * words;
+	a.insert    = insert + (size_t)x0 * words;
+	a.dirty     = dirty + (size_t)x0 * words;
+	a.touched   = dirtysum + x0 / STRIP;
+	a.words     = words;
+
+	ScrollKernel(a, kernel);
+
+	for (uint64_t m = run; m; m &= m - 1) {
+		int x = x0 + Ctz64(m);
+		Randomise(x);
+		ScrollDown(x);
+	}
+}
+
+void MatrixEngine::ClearDirty()
+{
+	//only the columns that were marked have anything to clear
+	for (int i = 0; i < stride / STRIP; i++) {
+		for (uint64_t m = dirtysum[i]; m; m &= m - 1) {
+			uint64_t *d = dirty + (size_t)(i * STRIP + Ctz64(m)) * words;
+			for (int w = 0; w < words; w++) d[w] = 0;
+		}
+		dirtysum[i] = 0;
+	}
+}
+
+int MatrixEngine::Intensity(int x, int y) const
+{
+	int in = intensity[y * stride + x];
+
+	if (in < 0)
+		return -1;
+
+	int b = blippos[x];
+	if (b == y || b+1 == y || b+8 == y || b+9 == y)
+		return MATRIX_BLIP;
+
+	return in;
+}
@@ -0,0 +1,163 @@
+#ifndef MATRIX_ENGINE_INC
+#define MATRIX_ENGINE_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "bits.h"
+#include "wheel.h"
+
+//
+//	Portable rain simulation - no Win32 in here. The saver (Matrix.cpp)
+//	and the headless tools are both just consumers of MatrixEngine.
+//
+
+#define DENSITY_MIN 5
+#define DENSITY_MAX 50
+
+#define MATRIX_NUMGLYPHS	26		//glyphs per row in matrix.bmp, the default glyph count
+#define MATRIX_MAXGLYPHS	4096	//glyph sets can be up to this big
+#define MATRIX_BLIP			4		//intensity value reported for blip cells
+#define MATRIX_BRIGHT		3		//intensity of a freshly inserted digit
+
+class ThreadPool;
+class Rng;
+
+//
+//	The whole grid: create it, step it, read back the dirty cells.
+//
+//	Storage is structure-of-arrays in one aligned arena. The per-cell
+//	fields are row-major 2D buffers (cell (x,y) is at y * stride + x, with
+//	stride a whole number of cache lines) and the per-column scalars are
+//	parallel arrays indexed by x:
+//
+//		glyph		glyph index of each cell
+//		intensity	-1 for blank, else 0 (dim) .. MATRIX_BRIGHT
+//
+//	Dirty cells are a bitset per column (bit y of column x's words) with
+//	a summary bit per column on top, so clearing and walking them only
+//	touches the columns that changed.
+//
+//	Every column draws from its own random stream, seeded from the engine
+//	seed and its index, so a column's future never depends on the other
+//	columns. That is what lets Step hand column strips to worker threads
+//	and still produce the same grid whatever the thread count.
+//
+//	Columns wait (initcount) before they start and swap between inserting
+//	blanks and digits (statecount). Rather than counting these down every
+//	tick, each column files the tick they run out on in a timing wheel, and
+//	Step only visits the strips that have a running column in them.
+//
+class MatrixEngine
+{
+public:
+	MatrixEngine();
+	~MatrixEngine();
+
+	void Create(int maxcols, int maxrows, int density, uint64_t seed);
+	void Destroy();
+
+	// Set the visible area; columns outside it are reset so they start
+	// afresh when the area grows again. Values are clamped to the grid.
+	void Resize(int numcols, int numrows);
+
+	// Advance every visible column by one tick. Dirty cells accumulate
+	// over any number of steps until the renderer calls ClearDirty.
+	void Step();
+	void ClearDirty();
+
+	// Glyphs to pick from, 1..MATRIX_MAXGLYPHS (MATRIX_NUMGLYPHS by
+	// default). Cells already on the grid are folded into the new range.
+	void SetGlyphs(int count);
+	int  NumGlyphs() const { return numglyphs; }
+
+	// Pick the ScrollKernel implementation (SIMD_AUTO by default)
+	void SetKernel(int level) { kernel = level; }
+
+	// Threads used by Step, counting the caller; <= 0 for one per core.
+	// The default is 1, which steps everything on the calling thread.
+	void SetThreads(int threads);
+	int  Threads() const;
+
+	// The pool behind SetThreads (0 when stepping on the caller only),
+	// for renderers that want to share it
+	ThreadPool *Pool() const { return pool; }
+
+	int  MaxCols() const { return maxcols; }
+	int  MaxRows() const { return maxrows; }
+	int  NumCols() const { return numcols; }
+	int  NumRows() const { return numrows; }
+	int  Stride()  const { return stride; }
+
+	bool IsDirty(int x, int y) const { return TestBit(dirty + (size_t)x * words, y); }
+
+	// The dirty cells in column order, without scanning the grid:
+	//	for (x = NextDirtyColumn(0); x < NumCols(); x = NextDirtyColumn(x + 1))
+	//		for (y = NextDirtyRow(x, 0); y < NumRows(); y = NextDirtyRow(x, y + 1))
+	int  NextDirtyColumn(int x)      const { return NextSetBit(dirtysum, numcols, x); }
+	int  NextDirtyRow(int x, int y)  const { return NextSetBit(dirty + (size_t)x * words, numrows, y); }
+
+	// Glyph index (0..NumGlyphs()-1) of a non-blank cell
+	int  Glyph(int x, int y) const { return glyph[y * stride + x]; }
+
+	// -1 for a blank cell, 0..3 for a digit, MATRIX_BLIP when the blip covers it
+	int  Intensity(int x, int y) const;
+
+	// Raw rows for renderers that walk the grid linearly
+	const unsigned short *GlyphRow(int y)     const { return glyph + y * stride; }
+	const signed char    *IntensityRow(int y) const { return intensity + y * stride; }
+
+private:
+	void StepColumns(int x0, int x1);
+	void InitColumn(int x);
+	void Start(int x);
+	void Flip(int x);
+	void ToggleState(int x);
+	void Pause(int x);
+	void ScrollDown(int x);
+	void Randomise(int x);
+	void MarkBlip(int x);
+
+	void *arena;			//everything below lives in this one block
+
+	unsigned short *glyph;
+	signed char    *intensity;
+	uint64_t       *dirty;		//words uint64s per column
+	uint64_t       *dirtysum;	//one bit per column with anything in dirty
+
+	int *state;				//0 (insert blanks) or 1 (insert digits)
+	int *statecount;		//how long to stay in current state (flipat has the live count)
+	int *initcount;			//ticks before we are allowed to start, once visible
+	int *blippos;			//vertical position of the bright "blip" that shoots downwards
+	int *bliplen;			//how long (a random value) does the blip last?
+	unsigned char *started;	//have we started this run yet??
+	Rng *rng;				//each column's random stream
+
+	uint32_t *startat;		//tick the pending start event is for, or NEVER
+	uint32_t *flipat;		//tick the pending state flip is for, or NEVER
+	uint64_t *running;		//one bit per started column, a word per strip
+	uint32_t  tick;			//ticks stepped since Create
+	TimingWheel wheel;
+	std::vector<uint32_t> due;	//events popped this tick
+	std::vector<int>      work;	//strips with a running column this tick
+
+	//ScrollKernel lane state and results, see kernel.h
+	unsigned char *active;
+	signed char   *laneold;
+	unsigned char *laneskip;
+	uint64_t      *bright;
+	uint64_t      *insert;
+	int            words;		//uint64s per column in bright/insert/dirty
+
+	int maxcols, maxrows;
+	int numcols, numrows;
+	int runlen;				//rows of storage per column (maxrows + 1 for luck)
+	int stride;				//elements per row in the 2D buffers
+	int density;
+	int numglyphs;
+	int kernel;
+
+	ThreadPool *pool;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "feed.h"
+
+static void Nap(int ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void MessageFeed::Start(FeedOpen open, void *ctx)
+{
+	Stop();
+
+	state = std::make_shared<State>();
+	std::thread(&MessageFeed::Reader, state, open, ctx).detach();
+}
+
+void MessageFeed::Stop()
+{
+	if(state)
+		state->stop = true;
+
+	//the reader keeps its own reference, and lets go when it sees stop
+	state.reset();
+}
+
+//
+//	Clean up a line and queue it. Control characters go, leading and
+//	trailing spaces go, and a line too long is cut at a character
+//	boundary.
+//
+void MessageFeed::Deliver(State &s, const char *text, size_t len)
+{
+	FeedLine line;
+	size_t n = 0;
+
+	for(size_t i = 0; i < len && n < FEED_LINELEN - 1; i++)
+	{
+		unsigned char c = (unsigned char)text[i];
+		if(c < 0x20 || c == 0x7f) continue;
+		if(c == ' ' && n == 0) continue;
+		line.text[n++] = (char)c;
+	}
+
+	//don't leave half a UTF-8 sequence at the end: back up to the last
+	//lead byte and drop it only if it wants more bytes than follow it
+	if(n == FEED_LINELEN - 1)
+	{
+		size_t k = n;
+		while(k > 0 && n - k < 3 && ((unsigned char)line.text[k - 1] & 0xc0) == 0x80) k--;
+
+		if(k > 0)
+		{
+			unsigned char lead = (unsigned char)line.text[k - 1];
+			size_t want = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+			if(n - (k - 1) < want) n = k - 1;
+		}
+	}
+
+	while(n > 0 && line.text[n - 1] == ' ') n--;
+
+	if(n == 0) return;
+	line.text[n] = 0;
+
+	s.lines++;
+
+	//while the display hasn't taken the slot it is still behind, so
+	//there's no point waiting on the queue again
+	if(s.newest.load() == 0)
+	{
+		for(int waited = 0; waited < FEED_WAIT_MS; waited += FEED_POLL_MS / 10)
+		{
+			if(s.queue.TryPush(line))
+				return;
+
+			if(s.stop)
+			{
+				s.dropped++;
+				return;
+			}
+			Nap(FEED_POLL_MS / 10);
+		}
+	}
+
+	FeedLine *old = s.newest.exchange(new FeedLine(line));
+	if(old)
+	{
+		delete old;
+		s.dropped++;
+	}
+}
+
+//
+//	Everything queued is older than the slot: the reader only fills the
+//	slot once the queue is full, and leaves the queue alone until the
+//	slot has been taken.
+//
+bool MessageFeed::TryPop(FeedLine &line)
+{
+	if(!state) return false;
+
+	uint32_t got = 0;
+	while(state->queue.TryPop(line)) got++;
+
+	if(FeedLine *last = state->newest.exchange(0))
+	{
+		line = *last;
+		delete last;
+		got++;
+	}
+
+	if(got > 1) state->dropped += got - 1;
+	return got > 0;
+}
+
+void MessageFeed::Reader(std::shared_ptr<State> s, FeedOpen open, void *ctx)
+{
+	FILE *fp = 0;
+	bool seekable = false;
+	std::string partial;		//a line still being written
+	char buf[1024];
+
+	while(!s->stop)
+	{
+		if(fp == 0)
+		{
+			fp = open(ctx);
+			if(fp == 0)
+			{
+				Nap(FEED_POLL_MS);
+				continue;
+			}
+
+			//tail a file from its end; a pipe has no end to seek to
+			seekable = fseek(fp, 0, SEEK_END) == 0 && ftell(fp) >= 0;
+			partial.clear();
+		}
+
+		if(fgets(buf, sizeof(buf), fp))
+		{
+			size_t len = strlen(buf);
+
+			if(len > 0 && buf[len - 1] == '\n')
+			{
+				partial.append(buf, len - 1);
+				Deliver(*s, partial.data(), partial.size());
+				partial.clear();
+			}
+			else if(partial.size() < 4 * FEED_LINELEN)
+			{
+				partial.append(buf, len);
+			}
+			continue;
+		}
+
+		if(!seekable || ferror(fp))
+		{
+			//the writer went away; wait for the next one
+			fclose(fp);
+			fp = 0;
+			Nap(FEED_POLL_MS);
+			continue;
+		}
+
+		//caught up with the file: notice truncation, then wait for more
+		clearerr(fp);
+		long pos = ftell(fp);
+		fseek(fp, 0, SEEK_END);
+		long end = ftell(fp);
+		fseek(fp, end < pos ? 0 : pos, SEEK_SET);
+		if(end < pos) partial.clear();
+
+		Nap(FEED_POLL_MS);
+	}
+
+	if(fp) fclose(fp);
+}
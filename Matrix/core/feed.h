@@ -0,0 +1,81 @@
+#ifndef MATRIX_FEED_INC
+#define MATRIX_FEED_INC
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include "spsc.h"
+
+#define FEED_LINELEN	256		//bytes of a line kept, with the terminator; longer lines are cut
+#define FEED_QUEUE		64		//lines waiting for the display
+#define FEED_POLL_MS	100		//how often a quiet or missing source is looked at again
+#define FEED_WAIT_MS	1000	//how long a line waits for room before it is dropped
+
+// a line from the feed, UTF-8, nul-terminated, never empty
+struct FeedLine
+{
+	char text[FEED_LINELEN];
+};
+
+// open the source for reading, or return 0 to try again later
+typedef FILE *(*FeedOpen)(void *ctx);
+
+//
+//	Lines from a log file or a pipe, read on a background thread and
+//	handed to the display through an SpscQueue, so the frame never waits
+//	on I/O.
+//
+//	A seekable source is tailed: reading starts at its end, new lines are
+//	picked up as they are appended, and a file that shrinks (truncated in
+//	place) is read again from the start. A log rotated to a new file isn't
+//	noticed. A pipe is read from wherever it is and reopened when its
+//	writer goes away. Blank lines and control characters are dropped.
+//
+//	Only the newest line is worth showing. TryPop empties the queue and
+//	hands back the last line in it. When the queue stays full the reader
+//	stops reading, which holds up a pipe's writer, for up to FEED_WAIT_MS;
+//	after that it reads on and leaves each line in a one-line slot that
+//	the next one replaces, until the display takes it. Lines passed over
+//	either way are counted as dropped.
+//
+class MessageFeed
+{
+public:
+	MessageFeed() {}
+	~MessageFeed() { Stop(); }
+
+	// open must stay callable with ctx until Stop
+	void Start(FeedOpen open, void *ctx);
+
+	// the reader may be blocked in a read, so it is left to finish on its own
+	void Stop();
+
+	bool Running() const { return state != 0; }
+
+	// consumer side, never blocks; the newest line waiting, if any
+	bool TryPop(FeedLine &line);
+
+	uint32_t Lines() const   { return state ? state->lines.load()   : 0; }	//read, ever
+	uint32_t Dropped() const { return state ? state->dropped.load() : 0; }	//passed over for a newer one
+	int      Pending() const { return state ? state->queue.Size() + (state->newest.load() != 0) : 0; }
+
+private:
+	struct State
+	{
+		State() : queue(FEED_QUEUE), newest(0), stop(false), lines(0), dropped(0) {}
+		~State() { delete newest.load(); }
+
+		SpscQueue<FeedLine> queue;
+		std::atomic<FeedLine *> newest;		//set by the reader once the queue is full, taken by TryPop
+		std::atomic<bool> stop;
+		std::atomic<uint32_t> lines, dropped;
+	};
+
+	static void Reader(std::shared_ptr<State> s, FeedOpen open, void *ctx);
+	static void Deliver(State &s, const char *text, size_t len);
+
+	std::shared_ptr<State> state;
+};
+
+#endif
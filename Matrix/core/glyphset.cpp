@@ -0,0 +1,156 @@
+#include <string.h>
+#include "glyphset.h"
+
+static uint32_t Scale(uint32_t c, int gain)
+{
+	uint32_t r = ((c >> 16) & 0xff) * gain >> 8;
+	uint32_t g = ((c >>  8) & 0xff) * gain >> 8;
+	uint32_t b = ( c        & 0xff) * gain >> 8;
+	return r << 16 | g << 8 | b;
+}
+
+static uint32_t Brightest(uint32_t c)
+{
+	uint32_t r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+	return r > g ? (r > b ? r : b) : (g > b ? g : b);
+}
+
+// how many glyphs the sheet can give for count, or 0
+static int Fit(const BmpImage &sheet, int cellw, int cellh, int count)
+{
+	if(cellw <= 0 || cellh <= 0)
+		return 0;
+
+	int cells = (sheet.width / cellw) * (sheet.height / cellh);
+
+	if(count <= 0 || count > cells) count = cells;
+	if(count > MATRIX_MAXGLYPHS) count = MATRIX_MAXGLYPHS;
+	return count > 0 ? count : 0;
+}
+
+// size atlas for count glyphs of the sheet; the count, or 0
+static int Layout(const BmpImage &sheet, int cellw, int cellh, int count, BmpImage &atlas)
+{
+	count = Fit(sheet, cellw, cellh, count);
+	if(count == 0)
+		return 0;
+
+	atlas.width  = count * cellw;
+	atlas.height = (MATRIX_BLIP + 1) * cellh;
+	atlas.colors = 0;
+	memset(atlas.palette, 0, sizeof(atlas.palette));
+	atlas.index.clear();
+	atlas.pixels.assign((size_t)atlas.width * atlas.height, 0);
+
+	return count;
+}
+
+// pixel (x,y) of glyph g's cell in the sheet
+static inline uint32_t SheetPixel(const BmpImage &sheet, int cellw, int cellh, int g, int x, int y)
+{
+	int across = sheet.width / cellw;
+	return sheet.pixels[(size_t)((g / across) * cellh + y) * sheet.width + (g % across) * cellw + x];
+}
+
+int BuildGlyphAtlas(const BmpImage &sheet, int cellw, int cellh, int count, BmpImage &atlas)
+{
+	count = Layout(sheet, cellw, cellh, count, atlas);
+	if(count == 0)
+		return 0;
+
+	//grey all over means a coverage mask
+	bool grey = true;
+	for(size_t i = 0; i < sheet.pixels.size() && grey; i++)
+	{
+		uint32_t p = sheet.pixels[i];
+		grey = ((p >> 16) & 0xff) == (p & 0xff) && ((p >> 8) & 0xff) == (p & 0xff);
+	}
+
+	for(int g = 0; g < count; g++)
+		for(int y = 0; y < cellh; y++)
+			for(int x = 0; x < cellw; x++)
+			{
+				uint32_t c = SheetPixel(sheet, cellw, cellh, g, x, y);
+
+				if(grey)
+					c = Scale(GLYPH_TINT, (int)(c & 0xff) + ((c & 0xff) >> 7));
+
+				size_t at = (size_t)y * atlas.width + g * cellw + x;
+
+				for(int level = 0; level <= MATRIX_BRIGHT; level++)
+					atlas.pixels[at + (size_t)level * cellh * atlas.width] = Scale(c, LevelGain[level]);
+
+				atlas.pixels[at + (size_t)MATRIX_BLIP * cellh * atlas.width] = BlipColor(c);
+			}
+
+	return count;
+}
+
+// put(at, level, coverage) for every pixel of every level of count glyphs, in an atlas width pixels across
+template<class Put>
+static void Cover(const BmpImage &sheet, int cellw, int cellh, int count, int width, Put put)
+{
+	uint32_t full = 0;
+	for(size_t i = 0; i < sheet.pixels.size(); i++)
+		if(Brightest(sheet.pixels[i]) > full) full = Brightest(sheet.pixels[i]);
+
+	if(full == 0) full = 255;
+
+	for(int g = 0; g < count; g++)
+		for(int y = 0; y < cellh; y++)
+			for(int x = 0; x < cellw; x++)
+			{
+				uint32_t cover = Brightest(SheetPixel(sheet, cellw, cellh, g, x, y));
+				cover = (cover * 255 + full / 2) / full;
+
+				size_t at = (size_t)y * width + g * cellw + x;
+
+				for(int level = 0; level <= MATRIX_BLIP; level++)
+					put(at + (size_t)level * cellh * width, level, cover);
+			}
+}
+
+int BuildThemeAtlas(const BmpImage &sheet, int cellw, int cellh, int count, const ShadeTable &shades, BmpImage &atlas)
+{
+	count = Layout(sheet, cellw, cellh, count, atlas);
+	if(count == 0 || shades.Shades() == 0)
+		return 0;
+
+	Cover(sheet, cellw, cellh, count, atlas.width, [&](size_t at, int level, uint32_t cover) {
+		atlas.pixels[at] = shades.Lut(level)[cover];
+	});
+
+	return count;
+}
+
+int BuildGlowAtlas(const BmpImage &sheet, int cellw, int cellh, int count, const ShadeTable &shades, std::vector<uint8_t> &glow)
+{
+	count = Fit(sheet, cellw, cellh, count);
+	if(count == 0 || shades.Shades() == 0)
+		return 0;
+
+	int width = count * cellw;
+	glow.assign((size_t)width * (MATRIX_BLIP + 1) * cellh, 0);
+
+	Cover(sheet, cellw, cellh, count, width, [&](size_t at, int level, uint32_t cover) {
+		glow[at] = shades.GlowLut(level)[cover];
+	});
+
+	return count;
+}
+
+void AtlasSheet(const BmpImage &atlas, int glyphs, BmpImage &sheet)
+{
+	int cellh = atlas.height / (MATRIX_BLIP + 1);
+
+	sheet.width  = glyphs > 0 ? atlas.width / glyphs * glyphs : 0;
+	sheet.height = cellh;
+	sheet.colors = 0;
+	sheet.index.clear();
+	sheet.pixels.resize((size_t)sheet.width * sheet.height);
+
+	for(int y = 0; y < sheet.height; y++)
+		memcpy(&sheet.pixels[(size_t)y * sheet.width],
+		       &atlas.pixels[(size_t)(MATRIX_BRIGHT * cellh + y) * atlas.width],
+		       sheet.width * sizeof(uint32_t));
+}
@@ -0,0 +1,44 @@
+#ifndef MATRIX_GLYPHSET_INC
+#define MATRIX_GLYPHSET_INC
+
+#include <vector>
+#include "bmp.h"
+#include "engine.h"
+#include "theme.h"
+
+#define GLYPH_TINT THEME_GREEN		//for grey sheets
+
+//
+//	Make a full atlas from a sheet of glyphs drawn once, instead of
+//	drawing every intensity by hand. The sheet is a grid of cellw x cellh
+//	cells read left to right, then down; count glyphs are taken from it,
+//	or every cell when count is 0.
+//
+//	Each glyph is taken as the brightest digit (MATRIX_BRIGHT). The dimmer
+//	levels are it scaled down, and the blip is it pushed towards white,
+//	by the same amounts as matrix.bmp's hand-drawn rows. A sheet with no
+//	colour in it (white or grey on black) is a coverage mask and is
+//	tinted GLYPH_TINT first.
+//
+//	The atlas has count glyphs across and the MATRIX_BLIP + 1 rows that
+//	SoftRenderer::SetAtlas and the GDI path expect. Returns the glyph
+//	count, or 0 if the sheet can't supply one.
+//
+int BuildGlyphAtlas(const BmpImage &sheet, int cellw, int cellh, int count, BmpImage &atlas);
+
+//
+//	The same, but in the colours of a theme: the sheet only gives each
+//	pixel's coverage (its brightest channel, against the brightest in the
+//	sheet), and every level is coverage through that level's LUT. There
+//	are still only the engine's four levels and the blip, whatever the
+//	number of shades; see ShadeTable.
+//
+int BuildThemeAtlas(const BmpImage &sheet, int cellw, int cellh, int count, const ShadeTable &shades, BmpImage &atlas);
+
+// and the same again as glow (0..255, one byte a pixel, same layout) for Afterglow
+int BuildGlowAtlas(const BmpImage &sheet, int cellw, int cellh, int count, const ShadeTable &shades, std::vector<uint8_t> &glow);
+
+// the MATRIX_BRIGHT row of an atlas with glyphs across, as a sheet for the above
+void AtlasSheet(const BmpImage &atlas, int glyphs, BmpImage &sheet);
+
+#endif
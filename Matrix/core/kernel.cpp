@@ -0,0 +1,184 @@
+#include "kernel.h"
+#include "engine.h"
+#include "simd.h"
+#include "bits.h"
+
+// set bit y in the bitset of every lane in mask m (lane 0 is column x0)
+static inline void Scatter(uint64_t *bits, int words, int x0, uint32_t m, int y)
+{
+	uint64_t b = (uint64_t)1 << (y & 63);
+	bits += (size_t)x0 * words + (y >> 6);
+
+	while(m)
+	{
+		bits[(size_t)Ctz32(m) * words] |= b;
+		m &= m - 1;
+	}
+}
+
+static inline uint32_t TailMask(int lanes, int x0, int numcols)
+{
+	int n = numcols - x0;
+	return n >= lanes ? (lanes == 32 ? 0xffffffffu : (1u << lanes) - 1) : (1u << n) - 1;
+}
+
+static void ScrollScalar(const ScrollArgs &a)
+{
+	for(int y = 0; y < a.numrows; y++)
+	{
+		signed char   *row  = a.intensity + (size_t)y * a.stride;
+
+		for(int x = 0; x < a.numcols; x++)
+		{
+			int run = row[x];
+
+			if(run == MATRIX_BRIGHT) Scatter(a.bright, a.words, x, 1, y);
+
+			if(!a.active[x]) continue;
+
+			if(a.skip[x])
+			{
+				a.skip[x] = 0;
+				a.old[x]  = (signed char)run;
+				continue;
+			}
+
+			int old = a.old[x];
+
+			if(run > old && run >= 0)
+			{
+				a.skip[x] = run == MATRIX_BRIGHT ? 0xff : 0;
+				run--;
+				Scatter(a.dirty, a.words, x, 1, y);
+				*a.touched |= (uint64_t)1 << x;
+			}
+			else if(old >= 0 && run < 0)
+			{
+				run = MATRIX_BRIGHT;
+				a.skip[x] = 0xff;
+				Scatter(a.insert, a.words, x, 1, y);
+				Scatter(a.dirty, a.words, x, 1, y);
+				*a.touched |= (uint64_t)1 << x;
+			}
+
+			row[x]   = (signed char)run;
+			a.old[x] = (signed char)run;
+		}
+	}
+}
+
+#ifdef MATRIX_HAVE_SSE2
+static void ScrollSSE2(const ScrollArgs &a)
+{
+	const __m128i minus1 = _mm_set1_epi8(-1);
+	const __m128i zero   = _mm_setzero_si128();
+	const __m128i one    = _mm_set1_epi8(1);
+	const __m128i bright = _mm_set1_epi8(MATRIX_BRIGHT);
+
+	for(int y = 0; y < a.numrows; y++)
+	{
+		signed char   *row  = a.intensity + (size_t)y * a.stride;
+
+		for(int x = 0; x < a.numcols; x += 16)
+		{
+			__m128i run = _mm_load_si128((const __m128i *)(row + x));
+			__m128i act = _mm_load_si128((const __m128i *)(a.active + x));
+			__m128i skp = _mm_load_si128((const __m128i *)(a.skip + x));
+			__m128i old = _mm_load_si128((const __m128i *)(a.old + x));
+
+			__m128i isbright = _mm_cmpeq_epi8(run, bright);
+			__m128i go       = _mm_andnot_si128(skp, act);
+
+			__m128i decay = _mm_and_si128(_mm_cmpgt_epi8(run, old), _mm_cmpgt_epi8(run, minus1));
+			__m128i ins   = _mm_and_si128(_mm_cmpgt_epi8(old, minus1), _mm_cmpgt_epi8(zero, run));
+			decay = _mm_and_si128(decay, go);
+			ins   = _mm_and_si128(ins, go);
+
+			__m128i next = _mm_sub_epi8(run, _mm_and_si128(decay, one));
+			next = _mm_or_si128(_mm_andnot_si128(ins, next), _mm_and_si128(ins, bright));
+
+
+			_mm_store_si128((__m128i *)(row + x), next);
+			_mm_store_si128((__m128i *)(a.old + x), next);
+			_mm_store_si128((__m128i *)(a.skip + x), _mm_or_si128(ins, _mm_and_si128(decay, isbright)));
+
+			uint32_t bm = (uint32_t)_mm_movemask_epi8(isbright) & TailMask(16, x, a.numcols);
+			uint32_t im = (uint32_t)_mm_movemask_epi8(ins);
+			uint32_t dm = (uint32_t)_mm_movemask_epi8(_mm_or_si128(decay, ins));
+
+			if(bm) Scatter(a.bright, a.words, x, bm, y);
+			if(im) Scatter(a.insert, a.words, x, im, y);
+			if(dm)
+			{
+				Scatter(a.dirty, a.words, x, dm, y);
+				*a.touched |= (uint64_t)dm << x;
+			}
+		}
+	}
+}
+#endif
+
+#ifdef MATRIX_HAVE_AVX2
+MATRIX_TARGET_AVX2 static void ScrollAVX2(const ScrollArgs &a)
+{
+	const __m256i minus1 = _mm256_set1_epi8(-1);
+	const __m256i zero   = _mm256_setzero_si256();
+	const __m256i one    = _mm256_set1_epi8(1);
+	const __m256i bright = _mm256_set1_epi8(MATRIX_BRIGHT);
+
+	for(int y = 0; y < a.numrows; y++)
+	{
+		signed char   *row  = a.intensity + (size_t)y * a.stride;
+
+		for(int x = 0; x < a.numcols; x += 32)
+		{
+			__m256i run = _mm256_load_si256((const __m256i *)(row + x));
+			__m256i act = _mm256_load_si256((const __m256i *)(a.active + x));
+			__m256i skp = _mm256_load_si256((const __m256i *)(a.skip + x));
+			__m256i old = _mm256_load_si256((const __m256i *)(a.old + x));
+
+			__m256i isbright = _mm256_cmpeq_epi8(run, bright);
+			__m256i go       = _mm256_andnot_si256(skp, act);
+
+			__m256i decay = _mm256_and_si256(_mm256_cmpgt_epi8(run, old), _mm256_cmpgt_epi8(run, minus1));
+			__m256i ins   = _mm256_and_si256(_mm256_cmpgt_epi8(old, minus1), _mm256_cmpgt_epi8(zero, run));
+			decay = _mm256_and_si256(decay, go);
+			ins   = _mm256_and_si256(ins, go);
+
+			__m256i next = _mm256_sub_epi8(run, _mm256_and_si256(decay, one));
+			next = _mm256_or_si256(_mm256_andnot_si256(ins, next), _mm256_and_si256(ins, bright));
+
+
+			_mm256_store_si256((__m256i *)(row + x), next);
+			_mm256_store_si256((__m256i *)(a.old + x), next);
+			_mm256_store_si256((__m256i *)(a.skip + x), _mm256_or_si256(ins, _mm256_and_si256(decay, isbright)));
+
+			uint32_t bm = (uint32_t)_mm256_movemask_epi8(isbright) & TailMask(32, x, a.numcols);
+			uint32_t im = (uint32_t)_mm256_movemask_epi8(ins);
+			uint32_t dm = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(decay, ins));
+
+			if(bm) Scatter(a.bright, a.words, x, bm, y);
+			if(im) Scatter(a.insert, a.words, x, im, y);
+			if(dm)
+			{
+				Scatter(a.dirty, a.words, x, dm, y);
+				*a.touched |= (uint64_t)dm << x;
+			}
+		}
+	}
+}
+#endif
+
+void ScrollKernel(const ScrollArgs &a, int level)
+{
+	switch(SimdResolve(level))
+	{
+#ifdef MATRIX_HAVE_AVX2
+	case SIMD_AVX2: ScrollAVX2(a); return;
+#endif
+#ifdef MATRIX_HAVE_SSE2
+	case SIMD_SSE2: ScrollSSE2(a); return;
+#endif
+	default:        ScrollScalar(a); return;
+	}
+}
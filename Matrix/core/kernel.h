@@ -0,0 +1,45 @@
+#ifndef MATRIX_KERNEL_INC
+#define MATRIX_KERNEL_INC
+
+#include <stdint.h>
+
+//
+//	The ScrollDown transitions for a whole grid at once.
+//
+//	Columns sit in vector lanes and the kernel walks down the rows, so each
+//	row of the (row-major) intensity buffer is one linear sweep. Per lane it
+//	applies exactly the rules of the scalar ScrollDown:
+//
+//		- a digit brighter than the cell above it dims by one level
+//		- a blank below a lit cell becomes a fresh bright digit
+//		- after an insert, or after dimming a bright digit, skip a row
+//
+//	Anything that needs a random number (the glyph of an inserted digit,
+//	and MatrixEngine::Randomise) is left to the caller, which gets the
+//	positions back as per-column bitsets so it can draw them in column order.
+//
+//	The kernel is called for one strip of at most 64 columns at a time, so
+//	a single uint64 summarises which of its columns changed.
+//
+struct ScrollArgs
+{
+	signed char   *intensity;	//row-major, stride elements per row
+	int stride;
+	int numcols, numrows;
+
+	const unsigned char *active;	//0xff for lanes that scroll this tick, else 0
+	signed char   *old;				//per lane: intensity of the cell above (seeded from state)
+	unsigned char *skip;			//per lane: skip the next row (scratch, zeroed by the caller)
+
+	//per-column bitsets, words uint64s per column, cleared by the caller
+	uint64_t *bright;			//cells that were MATRIX_BRIGHT before the scroll (all lanes)
+	uint64_t *insert;			//cells that became a new digit this tick
+	uint64_t *dirty;			//cells that changed (accumulates, never cleared here)
+	uint64_t *touched;			//bit x set for each lane that marked a dirty cell
+	int words;
+};
+
+// level is one of the SIMD_ values from simd.h; all levels give identical results
+void ScrollKernel(const ScrollArgs &a, int level);
+
+#endif
@@ -0,0 +1,204 @@
+#include <string.h>
+#include <algorithm>
+#include "maskcache.h"
+
+MaskCache::Entry *MaskCache::Find(const std::string &key)
+{
+	for(size_t i = 0; i < entries.size(); i++)
+		if(entries[i].key == key)
+			return &entries[i];
+	return 0;
+}
+
+bool MaskCache::Get(const std::string &key, BitMatrix &mask)
+{
+	Entry *e = Find(key);
+	if(e == 0) return false;
+
+	e->used = ++clock;
+
+	if(mask.Width() != e->width || mask.Height() != e->height)
+		mask.Create(e->width, e->height);
+	else
+		mask.Clear();
+
+	size_t bytes = (size_t)mask.Words() * sizeof(uint64_t);
+	for(int y = 0; y < e->rows; y++)
+		memcpy(mask.Row(y), &e->bits[(size_t)y * mask.Words()], bytes);
+
+	return true;
+}
+
+void MaskCache::Put(const std::string &key, const BitMatrix &mask)
+{
+	Entry *e = Find(key);
+
+	if(e == 0)
+	{
+		if(entries.size() >= MASKCACHE_ENTRIES)
+		{
+			//evict the least recently used
+			size_t lru = 0;
+			for(size_t i = 1; i < entries.size(); i++)
+				if(entries[i].used < entries[lru].used)
+					lru = i;
+			e = &entries[lru];
+		}
+		else
+		{
+			entries.push_back(Entry());
+			e = &entries.back();
+		}
+		e->key = key;
+	}
+
+	//trailing blank rows aren't stored
+	int rows = mask.Height();
+	while(rows > 0)
+	{
+		const uint64_t *r = mask.Row(rows - 1);
+		int w = 0;
+		while(w < mask.Words() && r[w] == 0) w++;
+		if(w < mask.Words()) break;
+		rows--;
+	}
+
+	e->width  = mask.Width();
+	e->height = mask.Height();
+	e->rows   = rows;
+	e->used   = ++clock;
+	e->bits.assign(rows ? mask.Row(0) : 0, rows ? mask.Row(0) + (size_t)rows * mask.Words() : 0);
+
+	changed = true;
+}
+
+void MaskCache::Clear()
+{
+	changed = !entries.empty();
+	entries.clear();
+}
+
+//
+//	File layout, little-endian:
+//
+//	  uint32 magic, version, count
+//	  count times:
+//	    uint32 keylen, width, height, rows
+//	    keylen bytes of key
+//	    rows * BitWords(width) uint64 mask words
+//
+//	Entries are written least recently used first, so reading them back
+//	in order rebuilds the same recency.
+//
+static bool Read32(FILE *fp, uint32_t &v)
+{
+	uint8_t b[4];
+	if(fread(b, 1, 4, fp) != 4) return false;
+	v = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+	return true;
+}
+
+static bool Write32(FILE *fp, uint32_t v)
+{
+	uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+	return fwrite(b, 1, 4, fp) == 4;
+}
+
+// bytes between the file position and end, -1 if the file can't seek
+static long BytesLeft(FILE *fp, long end)
+{
+	long pos = ftell(fp);
+	return pos < 0 || end < pos ? -1 : end - pos;
+}
+
+bool MaskCache::Read(FILE *fp)
+{
+	uint32_t magic, version, count;
+
+	entries.clear();
+	clock   = 0;
+	changed = false;
+
+	//sizes are checked against what the file really holds before anything
+	//is allocated, so a bad header can't ask for half a gigabyte
+	long start = ftell(fp), end;
+	if(start < 0 || fseek(fp, 0, SEEK_END) != 0) return false;
+	end = ftell(fp);
+	if(end < 0 || fseek(fp, start, SEEK_SET) != 0) return false;
+
+	if(!Read32(fp, magic) || magic != MASKCACHE_MAGIC) return false;
+	if(!Read32(fp, version) || version != MASKCACHE_VERSION) return false;
+	if(!Read32(fp, count) || count > MASKCACHE_ENTRIES) return false;
+
+	std::vector<Entry> in(count);
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		Entry &e = in[i];
+		uint32_t keylen, width, height, rows;
+
+		if(!Read32(fp, keylen) || !Read32(fp, width) || !Read32(fp, height) || !Read32(fp, rows))
+			return false;
+
+		//no bigger than Message::Create makes the grid
+		if(width > 0xffff || height > 0xffff || rows > height)
+			return false;
+
+		size_t n = (size_t)rows * BitWords((int)width);
+		long left = BytesLeft(fp, end);
+		if(left < 0 || keylen > (unsigned long)left || n > ((unsigned long)left - keylen) / 8)
+			return false;
+
+		e.key.resize(keylen);
+		if(keylen && fread(&e.key[0], 1, keylen, fp) != keylen)
+			return false;
+
+		e.width  = (int)width;
+		e.height = (int)height;
+		e.rows   = (int)rows;
+		e.used   = ++clock;
+
+		e.bits.resize(n);
+		for(size_t k = 0; k < n; k++)
+		{
+			uint32_t lo, hi;
+			if(!Read32(fp, lo) || !Read32(fp, hi)) return false;
+			e.bits[k] = (uint64_t)hi << 32 | lo;
+		}
+	}
+
+	entries.swap(in);
+	return true;
+}
+
+bool MaskCache::OlderEntry(const Entry *a, const Entry *b)
+{
+	return a->used < b->used;
+}
+
+bool MaskCache::Write(FILE *fp)
+{
+	std::vector<const Entry *> byage(entries.size());
+	for(size_t i = 0; i < entries.size(); i++)
+		byage[i] = &entries[i];
+
+	std::sort(byage.begin(), byage.end(), OlderEntry);
+
+	bool ok = Write32(fp, MASKCACHE_MAGIC) && Write32(fp, MASKCACHE_VERSION) &&
+	          Write32(fp, (uint32_t)byage.size());
+
+	for(size_t i = 0; ok && i < byage.size(); i++)
+	{
+		const Entry &e = *byage[i];
+
+		ok = Write32(fp, (uint32_t)e.key.size()) && Write32(fp, e.width) &&
+		     Write32(fp, e.height) && Write32(fp, e.rows) &&
+		     fwrite(e.key.data(), 1, e.key.size(), fp) == e.key.size();
+
+		for(size_t k = 0; ok && k < e.bits.size(); k++)
+			ok = Write32(fp, (uint32_t)e.bits[k]) && Write32(fp, (uint32_t)(e.bits[k] >> 32));
+	}
+
+	if(ok) changed = false;
+	return ok;
+}
@@ -0,0 +1,60 @@
+#ifndef MATRIX_MASKCACHE_INC
+#define MATRIX_MASKCACHE_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "bitmatrix.h"
+
+#define MASKCACHE_ENTRIES 64		//masks kept before the least recently used goes
+#define MASKCACHE_MAGIC   0x434d584d	//"MXMC"
+#define MASKCACHE_VERSION 1
+
+//
+//	Rasterized message masks, so a message that comes round again (or
+//	on the next run) is a lookup instead of font rendering. Keys are
+//	opaque byte strings; the caller puts everything that affects the
+//	mask into them (text, font, size, grid). Only the rows up to the last
+//	lit one are kept.
+//
+//	Read and Write use a compact binary file. A file that doesn't look
+//	right is ignored as a whole, since it is only ever a cache. Read
+//	seeks to find the file size, so it wants a real file.
+//
+class MaskCache
+{
+public:
+	MaskCache() : clock(0), changed(false) {}
+
+	// copies the cached mask into mask (resized to match); false on a miss
+	bool Get(const std::string &key, BitMatrix &mask);
+	void Put(const std::string &key, const BitMatrix &mask);
+
+	void Clear();
+	int  Size() const    { return (int)entries.size(); }
+	bool Changed() const { return changed; }	//since the last Read or Write
+
+	bool Read(FILE *fp);
+	bool Write(FILE *fp);
+
+private:
+	struct Entry
+	{
+		std::string key;
+		int width, height;		//of the mask
+		int rows;			//rows stored, the rest are clear
+		std::vector<uint64_t> bits;	//rows * BitWords(width)
+		uint32_t used;			//clock when last looked up
+	};
+
+	Entry *Find(const std::string &key);
+	static bool OlderEntry(const Entry *a, const Entry *b);
+
+	std::vector<Entry> entries;
+	uint32_t clock;
+	bool changed;
+};
+
+#endif
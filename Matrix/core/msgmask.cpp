@@ -0,0 +1,80 @@
+#include <string.h>
+#include "msgmask.h"
+#include "simd.h"
+
+static inline bool Dark(uint32_t p)
+{
+	uint32_t colorref = ((p >> 16) & 0xff) | (p & 0xff00) | ((p & 0xff) << 16);
+	return colorref < MSGMASK_THRESHOLD;
+}
+
+// threshold width pixels into out (BitWords(width) words); true if any were lit
+static bool ThresholdRow(const uint32_t *src, int width, uint64_t *out)
+{
+	uint64_t any = 0;
+	int x = 0;
+
+	for(int w = 0; w < BitWords(width); w++)
+	{
+		uint64_t bits = 0;
+		int end = x + 64 < width ? x + 64 : width;
+
+#ifdef MATRIX_HAVE_SSE2
+		//pixels are below 2^24, so the signed compare is fine
+		const __m128i lo8  = _mm_set1_epi32(0xff);
+		const __m128i mid8 = _mm_set1_epi32(0xff00);
+		const __m128i th   = _mm_set1_epi32(MSGMASK_THRESHOLD);
+
+		for(; x + 4 <= end; x += 4)
+		{
+			__m128i p = _mm_loadu_si128((const __m128i *)(src + x));
+			__m128i c = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), lo8),
+			            _mm_or_si128(_mm_and_si128(p, mid8), _mm_slli_epi32(_mm_and_si128(p, lo8), 16)));
+			uint64_t m = (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(c, th)));
+			bits |= m << (x & 63);
+		}
+#endif
+		for(; x < end; x++)
+			if(Dark(src[x])) bits |= (uint64_t)1 << (x & 63);
+
+		out[w] = bits;
+		any |= bits;
+	}
+
+	return any != 0;
+}
+
+void BuildMessageMask(const uint32_t *pixels, int pitch, int width, int height, BitMatrix &mask)
+{
+	mask.Clear();
+
+	if(width > mask.Width()) width = mask.Width();
+
+	if(width <= 0) return;
+
+	std::vector<uint64_t> bits(BitWords(width));
+	size_t bytes = bits.size() * sizeof(uint64_t);
+
+	int  curline   = -1;		//mask row for this pixel row, -1 until the text starts
+	bool lastempty = true;
+
+	for(int y = 0; y < height; y++)
+	{
+		bool empty = !ThresholdRow(pixels + (size_t)y * pitch, width, &bits[0]);
+
+		if(curline < 0)
+		{
+			if(empty) continue;
+			curline = y;
+		}
+
+		if(curline >= mask.Height())
+			break;
+
+		//a blank row goes in once, later ones in the same run land on top of it
+		memcpy(mask.Row(curline), &bits[0], bytes);
+
+		if(!empty || !lastempty) curline++;
+		lastempty = empty;
+	}
+}
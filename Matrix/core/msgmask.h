@@ -0,0 +1,22 @@
+#ifndef MATRIX_MSGMASK_INC
+#define MATRIX_MSGMASK_INC
+
+#include <stdint.h>
+#include "bitmatrix.h"
+
+#define MSGMASK_THRESHOLD 0x606060	//RGB(96,96,96) as a COLORREF
+
+//
+//	Turn rendered message text (dark on light, 0x00RRGGBB pixels, pitch
+//	pixels per row) into a cell mask, the way SetMessage always has: a
+//	pixel is lit when its COLORREF (0x00BBGGRR) is below MSGMASK_THRESHOLD,
+//	the first lit row keeps its place, and after that every run of blank
+//	rows is squeezed down to one. Rows and columns beyond the mask are
+//	dropped. The mask is cleared first.
+//
+//	Each row is thresholded straight into mask words, 4 pixels per SSE2
+//	compare, and blank rows are found from the words.
+//
+void BuildMessageMask(const uint32_t *pixels, int pitch, int width, int height, BitMatrix &mask);
+
+#endif
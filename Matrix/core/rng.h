@@ -0,0 +1,71 @@
+#ifndef MATRIX_RNG_INC
+#define MATRIX_RNG_INC
+
+#include <stdint.h>
+
+//
+//	xoshiro128** - 128 bits of state, 32-bit outputs, period 2^128-1.
+//	Cheap on 32-bit builds too, which the old 16-bit LFSR was chosen for.
+//
+//	Below(n) maps a full 32-bit output onto [0, n) with a multiply and a
+//	shift instead of %, so there is no divide. The bias that leaves is at
+//	most n / 2^32, far below anything visible for the ranges used here.
+//
+class Rng
+{
+public:
+	Rng() { Seed(0); }
+	explicit Rng(uint64_t seed, uint32_t stream = 0) { Seed(seed, stream); }
+
+	// distinct streams from the same seed are statistically independent
+	void Seed(uint64_t seed, uint32_t stream = 0)
+	{
+		uint64_t z = seed ^ ((uint64_t)stream * 0xD1B54A32D192ED03ull);
+
+		for(int i = 0; i < 4; i += 2)
+		{
+			uint64_t v = SplitMix64(z);
+			s[i]     = (uint32_t)v;
+			s[i + 1] = (uint32_t)(v >> 32);
+		}
+
+		//the all-zero state is the one fixed point
+		if((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;
+	}
+
+	uint32_t Next()
+	{
+		uint32_t result = Rotl(s[1] * 5, 7) * 9;
+		uint32_t t = s[1] << 9;
+
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = Rotl(s[3], 11);
+
+		return result;
+	}
+
+	// uniform in [0, n), n > 0
+	uint32_t Below(uint32_t n)
+	{
+		return (uint32_t)(((uint64_t)Next() * n) >> 32);
+	}
+
+private:
+	static uint32_t Rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+	static uint64_t SplitMix64(uint64_t &z)
+	{
+		uint64_t r = (z += 0x9E3779B97F4A7C15ull);
+		r = (r ^ (r >> 30)) * 0xBF58476D1CE4E5B9ull;
+		r = (r ^ (r >> 27)) * 0x94D049BB133111EBull;
+		return r ^ (r >> 31);
+	}
+
+	uint32_t s[4];
+};
+
+#endif
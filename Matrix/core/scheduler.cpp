@@ -0,0 +1,52 @@
+#include <chrono>
+#include "scheduler.h"
+
+int64_t SteadyClock::Now()
+{
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+FrameScheduler::FrameScheduler(Clock *c, int64_t stepus, int catchup)
+	: clock(c), step(stepus > 0 ? stepus : 1), maxcatchup(catchup > 0 ? catchup : 1),
+	  next(0), steps(0), dropped(0)
+{
+	Reset();
+}
+
+void FrameScheduler::Reset()
+{
+	next = clock->Now() + step;
+}
+
+void FrameScheduler::SetStep(int64_t stepus)
+{
+	if(stepus <= 0) stepus = 1;
+
+	//keep the time already waited towards the next step
+	next += stepus - step;
+	step = stepus;
+}
+
+int FrameScheduler::Due()
+{
+	int64_t now = clock->Now();
+
+	if(now < next)
+		return 0;
+
+	int64_t behind = (now - next) / step + 1;
+	int64_t run = behind < maxcatchup ? behind : maxcatchup;
+
+	next    += behind * step;
+	steps   += (uint64_t)run;
+	dropped += (uint64_t)(behind - run);
+
+	return (int)run;
+}
+
+int64_t FrameScheduler::UntilNext()
+{
+	int64_t wait = next - clock->Now();
+	return wait > 0 ? wait : 0;
+}
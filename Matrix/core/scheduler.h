@@ -0,0 +1,76 @@
+#ifndef MATRIX_SCHEDULER_INC
+#define MATRIX_SCHEDULER_INC
+
+#include <stdint.h>
+
+//
+//	Time source for the scheduler, in microseconds from an arbitrary origin.
+//	Must never go backwards.
+//
+class Clock
+{
+public:
+	virtual ~Clock() {}
+	virtual int64_t Now() = 0;
+};
+
+// std::chrono::steady_clock, which MSVC's runtime builds on QueryPerformanceCounter
+class SteadyClock : public Clock
+{
+public:
+	int64_t Now();
+};
+
+// a clock that only moves when told to, for driving the scheduler headless
+class FakeClock : public Clock
+{
+public:
+	FakeClock() : now(0) {}
+
+	int64_t Now() { return now; }
+	void    Advance(int64_t us) { now += us; }
+	void    Set(int64_t us) { now = us; }
+
+private:
+	int64_t now;
+};
+
+//
+//	Runs the simulation at a fixed logical rate, independent of how often
+//	the caller gets round to asking. Each call to Due() returns how many
+//	steps have fallen due since the last call; the caller runs them all
+//	and then presents once. If it has fallen more than maxcatchup steps
+//	behind, the excess is dropped (and counted) rather than replayed, so a
+//	stall never turns into a burst of fast-forward.
+//
+class FrameScheduler
+{
+public:
+	FrameScheduler(Clock *clock, int64_t stepus, int maxcatchup = 4);
+
+	// restart timing from now; the first step falls due one period later
+	void Reset();
+
+	// change the period without losing phase
+	void SetStep(int64_t stepus);
+
+	// steps to run now, 0..maxcatchup
+	int Due();
+
+	// microseconds until the next step is due (0 if one is already due)
+	int64_t UntilNext();
+
+	int64_t  Step()    const { return step; }
+	uint64_t Steps()   const { return steps; }
+	uint64_t Dropped() const { return dropped; }
+
+private:
+	Clock   *clock;
+	int64_t  step;
+	int      maxcatchup;
+	int64_t  next;			//clock time the next step falls due
+	uint64_t steps;			//steps handed out by Due()
+	uint64_t dropped;		//steps skipped because we fell too far behind
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+
+static void Clamp(int &v, int lo, int hi)
+{
+	if(v < lo) v = lo;
+	if(v > hi) v = hi;
+}
+
+void ClampSettings(MatrixSettings &s)
+{
+	Clamp(s.density,     DENSITY_MIN, DENSITY_MAX);
+	Clamp(s.matrixspeed, SPEED_MIN,   SPEED_MAX);
+	Clamp(s.fontsize,    FONT_MIN,    FONT_MAX);
+	Clamp(s.shimmer,     SHIMMER_MIN, SHIMMER_MAX);
+	Clamp(s.startupbudget, BUDGET_MIN, BUDGET_MAX);
+	Clamp(s.glyphwidth,  GLYPHCELL_MIN, GLYPHCELL_MAX);
+	Clamp(s.glyphheight, GLYPHCELL_MIN, GLYPHCELL_MAX);
+	Clamp(s.glyphcount,  0, MATRIX_MAXGLYPHS);
+	Clamp(s.shades,      SHADES_MIN, SHADES_MAX);
+	Clamp(s.afterglow,   GLOW_MIN,   GLOW_MAX);
+}
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char Lower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+// case-insensitive compare of [p, p+len) with a name
+static bool Same(const char *p, size_t len, const char *name)
+{
+	size_t i = 0;
+	for(; i < len && name[i]; i++)
+		if(Lower(p[i]) != Lower(name[i])) return false;
+	return i == len && name[i] == 0;
+}
+
+// leading digits, the way GetPrivateProfileInt reads them
+static int Number(const std::string &v)
+{
+	return (int)strtol(v.c_str(), 0, 10);
+}
+
+// each key names exactly one member
+struct SettingKey
+{
+	const char *name;
+	int         MatrixSettings::*i;
+	bool        MatrixSettings::*b;
+	std::string MatrixSettings::*str;
+};
+
+static const SettingKey keys[] =
+{
+	{ "MessageSpeed",      &MatrixSettings::messagespeed, 0, 0 },
+	{ "MessageShimmer",    &MatrixSettings::shimmer,      0, 0 },
+	{ "Density",           &MatrixSettings::density,      0, 0 },
+	{ "MatrixSpeed",       &MatrixSettings::matrixspeed,  0, 0 },
+	{ "FontSize",          &MatrixSettings::fontsize,     0, 0 },
+	{ "StartupBudget",     &MatrixSettings::startupbudget, 0, 0 },
+	{ "GlyphWidth",        &MatrixSettings::glyphwidth,   0, 0 },
+	{ "GlyphHeight",       &MatrixSettings::glyphheight,  0, 0 },
+	{ "GlyphCount",        &MatrixSettings::glyphcount,   0, 0 },
+	{ "Shades",            &MatrixSettings::shades,       0, 0 },
+	{ "Afterglow",         &MatrixSettings::afterglow,    0, 0 },
+	{ "FontBold",          0, &MatrixSettings::fontbold,  0 },
+	{ "RandomizeMessages", 0, &MatrixSettings::randomize, 0 },
+	{ "FontName",          0, 0, &MatrixSettings::fontname },
+	{ "MessageFeed",       0, 0, &MatrixSettings::feedpath },
+	{ "GlyphSheet",        0, 0, &MatrixSettings::glyphsheet },
+	{ "Theme",             0, 0, &MatrixSettings::theme },
+};
+
+#define NUMKEYS (sizeof(keys) / sizeof(keys[0]))
+
+void ParseSettings(const char *text, size_t len, const char *section, MatrixSettings &s)
+{
+	bool seen[NUMKEYS] = { false };
+	bool inside = false;
+	const char *end = text + len;
+
+	//a UTF-8 byte order mark
+	if(len >= 3 && memcmp(text, "\xef\xbb\xbf", 3) == 0)
+		text += 3;
+
+	for(const char *p = text; p < end; )
+	{
+		const char *eol = (const char *)memchr(p, '\n', end - p);
+		if(eol == 0) eol = end;
+
+		const char *a = p, *b = eol;
+		p = eol < end ? eol + 1 : end;
+
+		while(a < b && IsSpace(*a))     a++;
+		while(b > a && IsSpace(b[-1])) b--;
+
+		if(a == b || *a == ';')
+			continue;
+
+		if(*a == '[')
+		{
+			const char *close = (const char *)memchr(a, ']', b - a);
+			if(close == 0) continue;
+
+			//only the first copy of the section counts
+			if(inside) break;
+			inside = Same(a + 1, close - a - 1, section);
+			continue;
+		}
+
+		const char *eq = (const char *)memchr(a, '=', b - a);
+		if(!inside || eq == 0)
+			continue;
+
+		const char *k = eq;
+		while(k > a && IsSpace(k[-1])) k--;
+
+		const char *v = eq + 1;
+		while(v < b && IsSpace(*v)) v++;
+
+		if(b - v >= 2 && (*v == '"' || *v == '\'') && b[-1] == *v)
+		{
+			v++;
+			b--;
+		}
+
+		for(size_t i = 0; i < NUMKEYS; i++)
+		{
+			if(seen[i] || !Same(a, k - a, keys[i].name))
+				continue;
+
+			std::string value(v, b - v);
+
+			if(keys[i].i)        s.*keys[i].i = Number(value);
+			else if(keys[i].b)   s.*keys[i].b = Number(value) != 0;
+			else                 (s.*keys[i].str).swap(value);
+
+			seen[i] = true;
+			break;
+		}
+	}
+}
+
+//
+//	Snapshot layout, little-endian:
+//
+//	  uint32 magic, version, payload bytes
+//	  payload
+//	  uint32 FNV-1a of the payload
+//
+//	The payload is the stamp (two uint64 and a uint32), then every setting in the order
+//	of keys above: ints as uint32, bools as a byte, strings as a uint32
+//	length and the bytes, then the path the same way.
+//
+static void Put32(std::vector<uint8_t> &out, uint32_t v)
+{
+	for(int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+static void Put64(std::vector<uint8_t> &out, uint64_t v)
+{
+	Put32(out, (uint32_t)v);
+	Put32(out, (uint32_t)(v >> 32));
+}
+
+static void PutString(std::vector<uint8_t> &out, const std::string &str)
+{
+	Put32(out, (uint32_t)str.size());
+	out.insert(out.end(), str.begin(), str.end());
+}
+
+static uint32_t Fnv1a(const uint8_t *p, size_t n)
+{
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < n; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+uint32_t SettingsHash(const void *data, size_t len)
+{
+	return Fnv1a((const uint8_t *)data, len);
+}
+
+void EncodeSnapshot(const SettingsSnapshot &snap, std::vector<uint8_t> &out)
+{
+	std::vector<uint8_t> body;
+
+	Put64(body, snap.size);
+	Put64(body, snap.time);
+	Put32(body, snap.hash);
+
+	const MatrixSettings &s = snap.settings;
+
+	for(size_t i = 0; i < NUMKEYS; i++)
+	{
+		if(keys[i].i)        Put32(body, (uint32_t)(s.*keys[i].i));
+		else if(keys[i].b)   body.push_back(s.*keys[i].b ? 1 : 0);
+		else                 PutString(body, s.*keys[i].str);
+	}
+
+	PutString(body, snap.path);
+
+	out.clear();
+	Put32(out, SNAPSHOT_MAGIC);
+	Put32(out, SNAPSHOT_VERSION);
+	Put32(out, (uint32_t)body.size());
+	out.insert(out.end(), body.begin(), body.end());
+	Put32(out, Fnv1a(&body[0], body.size()));
+}
+
+// reads from a buffer known to hold at least what is asked for
+struct Reader
+{
+	const uint8_t *p, *end;
+
+	bool Get32(uint32_t &v)
+	{
+		if(end - p < 4) return false;
+		v = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+		p += 4;
+		return true;
+	}
+
+	bool Get64(uint64_t &v)
+	{
+		uint32_t lo, hi;
+		if(!Get32(lo) || !Get32(hi)) return false;
+		v = (uint64_t)hi << 32 | lo;
+		return true;
+	}
+
+	bool GetString(std::string &str)
+	{
+		uint32_t n;
+		if(!Get32(n) || (size_t)(end - p) < n) return false;
+		str.assign((const char *)p, n);
+		p += n;
+		return true;
+	}
+};
+
+bool DecodeSnapshot(const void *data, size_t size, SettingsSnapshot &snap)
+{
+	Reader r = { (const uint8_t *)data, (const uint8_t *)data + size };
+	uint32_t magic, version, bytes, sum;
+
+	if(!r.Get32(magic) || magic != SNAPSHOT_MAGIC) return false;
+	if(!r.Get32(version) || version != SNAPSHOT_VERSION) return false;
+	if(!r.Get32(bytes) || (size_t)(r.end - r.p) != (size_t)bytes + 4) return false;
+
+	const uint8_t *body = r.p;
+	Reader t = { body + bytes, r.end };
+	if(!t.Get32(sum) || sum != Fnv1a(body, bytes)) return false;
+
+	r.end = body + bytes;
+
+	SettingsSnapshot in;
+	if(!r.Get64(in.size) || !r.Get64(in.time) || !r.Get32(in.hash)) return false;
+
+	MatrixSettings &s = in.settings;
+
+	for(size_t i = 0; i < NUMKEYS; i++)
+	{
+		uint32_t v;
+
+		if(keys[i].i)
+		{
+			if(!r.Get32(v)) return false;
+			s.*keys[i].i = (int)v;
+		}
+		else if(keys[i].b)
+		{
+			if(r.p == r.end) return false;
+			s.*keys[i].b = *r.p++ != 0;
+		}
+		else if(!r.GetString(s.*keys[i].str))
+			return false;
+	}
+
+	if(!r.GetString(in.path) || r.p != r.end) return false;
+
+	ClampSettings(in.settings);
+	snap = in;
+	return true;
+}
@@ -0,0 +1,97 @@
+#ifndef MATRIX_SETTINGS_INC
+#define MATRIX_SETTINGS_INC
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "theme.h"
+
+#define SPEED_MIN	1
+#define SPEED_MAX	10
+
+#define MSGSPEED_MAX 500
+#define MSGSPEED_MIN 50
+
+#define FONT_MIN	8
+#define FONT_MAX	30
+
+#define SHIMMER_MIN	0
+#define SHIMMER_MAX	100
+
+#define BUDGET_MIN	0		//startup budget in ms; 0 for none
+#define BUDGET_MAX	60000
+
+#define GLYPHCELL_MIN	4		//glyph sheet cell size in pixels
+#define GLYPHCELL_MAX	64
+
+#define GLOW_MIN	0		//afterglow kept per frame, percent; 0 for none
+#define GLOW_MAX	95
+
+#define SNAPSHOT_MAGIC   0x5353584d		//"MXSS"
+#define SNAPSHOT_VERSION 6
+
+//
+//	The saver's settings, as one typed struct. Strings are UTF-8.
+//
+struct MatrixSettings
+{
+	int  messagespeed;
+	int  shimmer;
+	int  density;
+	int  matrixspeed;
+	int  fontsize;
+	int  startupbudget;
+	int  glyphwidth;		//cells of glyphsheet; glyphcount 0 takes them all
+	int  glyphheight;
+	int  glyphcount;
+	int  shades;			//SHADES_MIN..SHADES_MAX, for a theme
+	int  afterglow;
+	bool fontbold;
+	bool randomize;
+	std::string fontname;
+	std::string feedpath;
+	std::string glyphsheet;		//empty for the built-in glyphs
+	std::string theme;			//for ParseTheme; empty for the glyphs' own colours
+};
+
+// the ranges the config dialogs offer; messagespeed is left alone
+void ClampSettings(MatrixSettings &s);
+
+//
+//	Read the keys of one section of an INI file (UTF-8 text) into s, in
+//	a single pass. Keys that aren't there keep the value s already has,
+//	so fill it with the defaults first. Matching follows
+//	GetPrivateProfileString: section and key names ignore case, only the
+//	first copy of a repeated section is read and the first of a repeated
+//	key in it wins, values are trimmed and lose one pair of surrounding
+//	quotes, and numbers are read from their leading digits.
+//
+void ParseSettings(const char *text, size_t len, const char *section, MatrixSettings &s);
+
+//
+//	A binary copy of parsed settings, along with where they came from and
+//	what the file looked like (stamp: size and modification time, however
+//	the platform likes, and SettingsHash of its bytes). If the file still
+//	has the same stamp, the copy can be used instead of finding and
+//	parsing the file again. The hash catches an edit that keeps the size
+//	within the modification time's granularity (2 s on FAT).
+//
+struct SettingsSnapshot
+{
+	MatrixSettings settings;
+	std::string    path;		//the settings file, UTF-8
+	uint64_t       size, time;
+	uint32_t       hash;
+};
+
+// FNV-1a of the settings file as it is on disk
+uint32_t SettingsHash(const void *data, size_t len);
+
+void EncodeSnapshot(const SettingsSnapshot &snap, std::vector<uint8_t> &out);
+
+// false for anything short, damaged or from another version
+bool DecodeSnapshot(const void *data, size_t size, SettingsSnapshot &snap);
+
+#endif
@@ -0,0 +1,60 @@
+#include "simd.h"
+
+#if defined(_MSC_VER) && defined(MATRIX_HAVE_AVX2)
+#include <intrin.h>
+#endif
+
+static int DetectLevel(void)
+{
+#if defined(MATRIX_HAVE_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx     = (info[2] & (1 << 28)) != 0;
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+
+		//the OS must save the YMM registers on a context switch
+		if(osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+			return SIMD_AVX2;
+	}
+	return SIMD_SSE2;
+#elif defined(MATRIX_HAVE_AVX2)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	return SIMD_SSE2;
+#elif defined(MATRIX_HAVE_SSE2)
+	return SIMD_SSE2;
+#else
+	return SIMD_SCALAR;
+#endif
+}
+
+int SimdLevel(void)
+{
+	static int level = DetectLevel();
+	return level;
+}
+
+int SimdResolve(int level)
+{
+	if(level < 0 || level > SimdLevel())
+		return SimdLevel();
+
+	return level;
+}
+
+const char *SimdName(int level)
+{
+	switch(level)
+	{
+	case SIMD_SSE2: return "sse2";
+	case SIMD_AVX2: return "avx2";
+	default:        return "scalar";
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef MATRIX_SIMD_INC
+#define MATRIX_SIMD_INC
+
+#include <stdint.h>
+
+//
+//	Instruction set selection for the vector kernels.
+//
+//	SSE2 is part of the x64 baseline (and of any /arch:SSE2 x86 build), so
+//	it is used unconditionally when the compiler targets it. AVX2 code is
+//	compiled per-function with MATRIX_TARGET_AVX2 and only called after
+//	SimdLevel() has checked the CPU and OS support it.
+//
+
+#define SIMD_SCALAR		0
+#define SIMD_SSE2		1
+#define SIMD_AVX2		2
+#define SIMD_AUTO		(-1)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATRIX_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(MATRIX_HAVE_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define MATRIX_HAVE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MATRIX_TARGET_AVX2
+#else
+#define MATRIX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// best level this machine can run (cached after the first call)
+int SimdLevel(void);
+
+// clamp a requested level (or SIMD_AUTO) to what is actually available
+int SimdResolve(int level);
+
+const char *SimdName(int level);
+
+#endif
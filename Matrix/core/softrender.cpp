@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#include "softrender.h"
+#include "engine.h"
+#include "drawlist.h"
+#include "aligned.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#define BAND_ALIGN 16			//columns per band are a multiple of this: 16 pixels is a cache line
+
+// pixels per atlas row: rows start 32 bytes apart
+static inline int CellPitch(int w) { return (w + 7) & ~7; }
+
+//
+//	Cell copies with the size known at compile time, so every row is a
+//	fixed run of vector moves with no loop or length checks left in it.
+//	Rows that aren't a whole number of vectors finish with one overlapping
+//	move ending on the last pixel (cells are at least 8 pixels wide).
+//
+template<int W>
+static inline void CopyRow(uint32_t *dst, const uint32_t *src)
+{
+#ifdef MATRIX_HAVE_SSE2
+	for(int i = 0; i + 4 <= W; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_load_si128((const __m128i *)(src + i)));
+	if(W % 4)
+		_mm_storeu_si128((__m128i *)(dst + W - 4), _mm_loadu_si128((const __m128i *)(src + W - 4)));
+#else
+	memcpy(dst, src, W * sizeof(uint32_t));
+#endif
+}
+
+template<int W>
+static inline void FillRow(uint32_t *dst, uint32_t c)
+{
+#ifdef MATRIX_HAVE_SSE2
+	__m128i v = _mm_set1_epi32((int)c);
+	for(int i = 0; i + 4 <= W; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + i), v);
+	if(W % 4)
+		_mm_storeu_si128((__m128i *)(dst + W - 4), v);
+#else
+	for(int i = 0; i < W; i++) dst[i] = c;
+#endif
+}
+
+template<int W, int H>
+struct Cell
+{
+	static void Blit(uint32_t *dst, int pitch, const uint32_t *src)
+	{
+		for(int y = 0; y < H; y++)
+			CopyRow<W>(dst + (size_t)y * pitch, src + y * ((W + 7) & ~7));
+	}
+
+	static void Fill(uint32_t *dst, int pitch, uint32_t c)
+	{
+		for(int y = 0; y < H; y++)
+			FillRow<W>(dst + (size_t)y * pitch, c);
+	}
+};
+
+// one entry per cell size, [h - CELL_MIN][w - CELL_MIN]
+template<int H, size_t... W>
+static void BuildRow(SoftRenderer::CellOps *ops, std::index_sequence<W...>)
+{
+	SoftRenderer::CellOps row[] = { { &Cell<CELL_MIN + (int)W, H>::Blit, &Cell<CELL_MIN + (int)W, H>::Fill }... };
+	for(size_t i = 0; i < sizeof...(W); i++) ops[i] = row[i];
+}
+
+template<size_t... H>
+static void BuildTable(SoftRenderer::CellOps *ops, std::index_sequence<H...>)
+{
+	int expand[] = { (BuildRow<CELL_MIN + (int)H>(ops + H * CELL_SIZES, std::make_index_sequence<CELL_SIZES>()), 0)... };
+	(void)expand;
+}
+
+static const SoftRenderer::CellOps *CellTable()
+{
+	static SoftRenderer::CellOps ops[CELL_SIZES * CELL_SIZES];
+	static bool built = (BuildTable(ops, std::make_index_sequence<CELL_SIZES>()), true);
+	(void)built;
+	return ops;
+}
+
+SoftRenderer::SoftRenderer()
+	: pixels(0), width(0), height(0), pitch(0), cells(0), cellw(0), cellh(0), cellsize(0), numglyphs(0), ops(0)
+{
+}
+
+SoftRenderer::~SoftRenderer()
+{
+	Destroy();
+	AlignedFree(cells);
+}
+
+bool SoftRenderer::SetAtlas(const BmpImage &img, int glyphs)
+{
+	if(glyphs <= 0)
+		return false;
+
+	//glyphs across, intensities 0..MATRIX_BRIGHT and the blip down
+	int w = img.width / glyphs;
+	int h = img.height / (MATRIX_BLIP + 1);
+
+	if(w <= 0 || h <= 0)
+		return false;
+
+	cellw     = w;
+	cellh     = h;
+	cellsize  = CellPitch(w) * h;
+	numglyphs = glyphs;
+
+	//each glyph/intensity variant becomes one contiguous block of aligned rows
+	AlignedFree(cells);
+	cells = (uint32_t *)AlignedAlloc((size_t)glyphs * (MATRIX_BLIP + 1) * cellsize * sizeof(uint32_t));
+
+	for(int sy = 0; sy <= MATRIX_BLIP; sy++)
+		for(int g = 0; g < glyphs; g++)
+		{
+			uint32_t *dst = cells + (size_t)(sy * glyphs + g) * cellsize;
+			for(int y = 0; y < h; y++)
+			{
+				memcpy(dst + y * CellPitch(w), &img.pixels[(size_t)(sy * h + y) * img.width + g * w], w * sizeof(uint32_t));
+				memset(dst + y * CellPitch(w) + w, 0, (CellPitch(w) - w) * sizeof(uint32_t));
+			}
+		}
+
+	//sizes outside the table go through the clipped copies
+	ops = 0;
+	if(w >= CELL_MIN && w <= CELL_MAX && h >= CELL_MIN && h <= CELL_MAX)
+		ops = &CellTable()[(h - CELL_MIN) * CELL_SIZES + (w - CELL_MIN)];
+
+	return true;
+}
+
+bool SoftRenderer::LoadAtlas(const char *path)
+{
+	BmpImage img;
+	return LoadBmp(path, img) && SetAtlas(img);
+}
+
+void SoftRenderer::Create(int w, int h)
+{
+	Destroy();
+
+	width  = w;
+	height = h;
+	pitch  = (int)AlignUp(w, MATRIX_CACHELINE / sizeof(uint32_t));
+	pixels = (uint32_t *)AlignedAlloc((size_t)pitch * height * sizeof(uint32_t));
+
+	Clear();
+}
+
+void SoftRenderer::Destroy()
+{
+	AlignedFree(pixels);
+	pixels = 0;
+	width = height = pitch = 0;
+}
+
+void SoftRenderer::Clear()
+{
+	memset(pixels, 0, (size_t)pitch * height * sizeof(uint32_t));
+}
+
+// the ExtTextOut(ETO_OPAQUE) of a blank cell, clipped to the framebuffer
+// (also for cell sizes without a specialised copy)
+void SoftRenderer::Fill(int px, int py, uint32_t c)
+{
+	int w = px + cellw <= width  ? cellw : width - px;
+	int h = py + cellh <= height ? cellh : height - py;
+
+	for(int y = 0; y < h; y++)
+	{
+		uint32_t *dst = pixels + (size_t)(py + y) * pitch + px;
+		for(int x = 0; x < w; x++) dst[x] = c;
+	}
+}
+
+// the BitBlt from hdcSymbols, clipped to the framebuffer
+void SoftRenderer::Blit(int px, int py, const uint32_t *src)
+{
+	int w = px + cellw <= width  ? cellw : width - px;
+	int h = py + cellh <= height ? cellh : height - py;
+
+	for(int y = 0; y < h; y++)
+		memcpy(pixels + (size_t)(py + y) * pitch + px, src + y * CellPitch(cellw), w * sizeof(uint32_t));
+}
+
+// first command in [b, e) at or right of column x (commands are in column order)
+static int LowerBound(const DrawCmd *cmds, int b, int e, int x)
+{
+	while(b < e)
+	{
+		int m = (b + e) / 2;
+		if(cmds[m].x < x) b = m + 1;
+		else              e = m;
+	}
+	return b;
+}
+
+void SoftRenderer::Draw(const DrawList &list, ThreadPool *pool)
+{
+	if(pixels == 0 || cells == 0 || list.Size() == 0)
+		return;
+
+	//columns that reach the framebuffer, in bands of whole cache lines
+	int cols  = (width + cellw - 1) / cellw;
+	int bands = pool ? pool->Threads() * 4 : 1;
+	int span  = (cols + bands - 1) / bands;
+
+	span  = (span + BAND_ALIGN - 1) & ~(BAND_ALIGN - 1);
+	bands = (cols + span - 1) / span;
+
+	auto band = [&](int i) {
+		const DrawCmd *cmds = list.Commands();
+		int x0 = i * span, x1 = x0 + span;
+
+		//the rain, then the overlays on top of it
+		DrawRange(list, LowerBound(cmds, 0, list.Base(), x0), LowerBound(cmds, 0, list.Base(), x1));
+		DrawRange(list, LowerBound(cmds, list.Base(), list.Size(), x0), LowerBound(cmds, list.Base(), list.Size(), x1));
+	};
+
+	//ParallelFor returns once every band is done, so the frame is complete
+	if(pool == 0 || bands < 2)
+	{
+		for(int i = 0; i < bands; i++) band(i);
+		return;
+	}
+
+	pool->ParallelFor(bands, band);
+}
+
+void SoftRenderer::DrawRange(const DrawList &list, int b, int e)
+{
+	const DrawCmd  *cmds = list.Commands();
+	const uint16_t *src  = list.Cells();
+
+	for(int i = b; i < e; i++)
+	{
+		const DrawCmd &c = cmds[i];
+
+		int px = c.x * cellw;
+		if(px >= width) continue;
+
+		//whole cells get the specialised copies
+		bool fast = ops != 0 && px + cellw <= width;
+
+		for(int k = 0; k < c.count; k++)
+		{
+			int py = (c.y + k) * cellh;
+			if(py >= height) break;
+
+			uint32_t *dst = pixels + (size_t)py * pitch + px;
+			const uint32_t *cell = c.op == DRAW_BLIT ? cells + (size_t)src[c.first + k] * cellsize : 0;
+
+			if(fast && py + cellh <= height)
+			{
+				if(cell) ops->blit(dst, pitch, cell);
+				else     ops->fill(dst, pitch, 0);
+			}
+			else
+			{
+				if(cell) Blit(px, py, cell);
+				else     Fill(px, py, 0);
+			}
+		}
+	}
+}
+
+bool SoftRenderer::WritePPM(const char *path) const
+{
+	FILE *fp = fopen(path, "wb");
+	if(fp == 0) return false;
+
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+
+	unsigned char *row = new unsigned char[(size_t)width * 3];
+
+	for(int y = 0; y < height; y++)
+	{
+		const uint32_t *src = pixels + (size_t)y * pitch;
+		for(int x = 0; x < width; x++)
+		{
+			row[x*3]   = (unsigned char)(src[x] >> 16);
+			row[x*3+1] = (unsigned char)(src[x] >> 8);
+			row[x*3+2] = (unsigned char)src[x];
+		}
+		fwrite(row, 1, (size_t)width * 3, fp);
+	}
+
+	delete[] row;
+	return fclose(fp) == 0;
+}
@@ -0,0 +1,81 @@
+#ifndef MATRIX_SOFTRENDER_INC
+#define MATRIX_SOFTRENDER_INC
+
+#include <stdint.h>
+#include "bmp.h"
+#include "engine.h"
+
+#define CELL_MIN 8				//smallest and largest cell sizes with their own copies
+#define CELL_MAX 32
+#define CELL_SIZES (CELL_MAX - CELL_MIN + 1)
+
+class DrawList;
+class ThreadPool;
+
+//
+//	Draws the grid into a CPU framebuffer, the way DecodeMatrix draws it
+//	with GDI: each dirty cell in the frame's DrawList is either cleared to
+//	black or gets the glyph's cell copied from the atlas (glyphs across, one
+//	row per intensity and the blip row below: matrix.bmp, or what
+//	BuildGlyphAtlas makes from a glyph sheet).
+//
+//	Pixels are 0x00RRGGBB, pitch pixels per row, top row first.
+//
+//	The atlas is rearranged on load so each glyph/intensity variant is one
+//	block of 32-byte aligned rows, and cells from CELL_MIN to CELL_MAX
+//	pixels on a side are drawn by copies specialised for that size.
+//
+class SoftRenderer
+{
+public:
+	SoftRenderer();
+	~SoftRenderer();
+
+	// The cell size is taken from the atlas dimensions and the glyph count
+	bool SetAtlas(const BmpImage &atlas, int glyphs = MATRIX_NUMGLYPHS);
+	bool LoadAtlas(const char *path);
+
+	// Size the framebuffer in pixels; it starts out black
+	void Create(int width, int height);
+	void Destroy();
+	void Clear();
+
+	// Play back one frame's commands. With a pool the framebuffer is split
+	// into column bands drawn in parallel; it returns once all are done.
+	void Draw(const DrawList &list, ThreadPool *pool = 0);
+
+	// Binary PPM (P6) of the current framebuffer
+	bool WritePPM(const char *path) const;
+
+	int  Width()  const { return width; }
+	int  Height() const { return height; }
+	int  Pitch()  const { return pitch; }
+	int  Glyphs()     const { return numglyphs; }
+	int  CellWidth()  const { return cellw; }
+	int  CellHeight() const { return cellh; }
+	const uint32_t *Pixels() const { return pixels; }
+	uint32_t       *Pixels()       { return pixels; }		//for drawing into from elsewhere (Afterglow)
+
+	// copies for one cell size; src is a cell of the rearranged atlas
+	struct CellOps
+	{
+		void (*blit)(uint32_t *dst, int pitch, const uint32_t *src);
+		void (*fill)(uint32_t *dst, int pitch, uint32_t c);
+	};
+
+private:
+	void Fill(int px, int py, uint32_t c);
+	void Blit(int px, int py, const uint32_t *src);
+	void DrawRange(const DrawList &list, int b, int e);
+
+	uint32_t *pixels;
+	int width, height, pitch;
+
+	uint32_t *cells;		//the atlas, one block per glyph/intensity
+	int cellw, cellh;
+	int cellsize;			//pixels per block
+	int numglyphs;			//glyphs across the atlas
+	const CellOps *ops;		//0 if the cell size has no specialised copy
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MATRIX_SPSC_INC
+#define MATRIX_SPSC_INC
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+//
+//	A bounded lock-free queue for exactly one producer thread and one
+//	consumer thread. Neither side ever waits: TryPush fails when the
+//	queue is full and TryPop when it is empty, and the caller decides
+//	what to do about it.
+//
+//	Each index is written by one side only and sits on its own cache
+//	line, so the two threads don't fight over them.
+//
+template<class T> class SpscQueue
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscQueue(int capacity) : head(0), tail(0)
+	{
+		uint32_t n = 1;
+		while((int)n < capacity) n <<= 1;
+		items.resize(n);
+		mask = n - 1;
+	}
+
+	int Capacity() const { return (int)items.size(); }
+
+	// producer only
+	bool TryPush(const T &item)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if(t - head.load(std::memory_order_acquire) > mask)
+			return false;
+
+		items[t & mask] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer only
+	bool TryPop(T &item)
+	{
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if(h == tail.load(std::memory_order_acquire))
+			return false;
+
+		item = items[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// a snapshot; either side may call it
+	int Size() const
+	{
+		return (int)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+	}
+
+private:
+	std::vector<T> items;
+	uint32_t mask;
+
+	char pad0[64];
+	std::atomic<uint32_t> head;		//next to pop, written by the consumer
+	char pad1[64 - sizeof(std::atomic<uint32_t>)];
+	std::atomic<uint32_t> tail;		//next to push, written by the producer
+	char pad2[64 - sizeof(std::atomic<uint32_t>)];
+};
+
+#endif
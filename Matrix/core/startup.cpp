@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include "startup.h"
+
+void StartupProfiler::Begin()
+{
+	start = last = clock->Now();
+	count = 0;
+	done  = false;
+}
+
+void StartupProfiler::Mark(const char *name)
+{
+	if(done) return;
+
+	int64_t now = clock->Now();
+
+	if(count < STARTUP_PHASES)
+	{
+		phase[count].name = name;
+		phase[count].us   = now - last;
+		count++;
+	}
+	else
+	{
+		phase[count - 1].name = "(more)";
+		phase[count - 1].us  += now - last;
+	}
+
+	last = now;
+}
+
+void StartupProfiler::Report(std::string &out, int64_t budgetus) const
+{
+	char line[128];
+	int64_t total = Total();
+	int slowest = 0;
+
+	for(int i = 1; i < count; i++)
+		if(phase[i].us > phase[slowest].us)
+			slowest = i;
+
+	snprintf(line, sizeof(line), "startup %.1f ms\n", total / 1000.0);
+	out = line;
+
+	for(int i = 0; i < count; i++)
+	{
+		snprintf(line, sizeof(line), "%c %-20s %9.1f ms %5.1f%%\n", i == slowest ? '*' : ' ',
+		         phase[i].name, phase[i].us / 1000.0, total > 0 ? 100.0 * phase[i].us / total : 0.0);
+		out += line;
+	}
+
+	if(budgetus <= 0)
+		snprintf(line, sizeof(line), "no budget\n");
+	else if(total > budgetus)
+		snprintf(line, sizeof(line), "OVER BUDGET: %.1f ms over %.1f ms\n", (total - budgetus) / 1000.0, budgetus / 1000.0);
+	else
+		snprintf(line, sizeof(line), "within budget of %.1f ms\n", budgetus / 1000.0);
+
+	out += line;
+}
@@ -0,0 +1,57 @@
+#ifndef MATRIX_STARTUP_INC
+#define MATRIX_STARTUP_INC
+
+#include <stdint.h>
+#include <string>
+#include "scheduler.h"
+
+#define STARTUP_PHASES 24		//marks kept; later ones are folded into the last
+
+//
+//	Times the phases of startup on a monotonic Clock. Begin sets the
+//	origin; each Mark closes the phase that has run since the previous
+//	mark (or Begin) and names it. Marks cost one clock read, so they can
+//	stay in release builds.
+//
+class StartupProfiler
+{
+public:
+	explicit StartupProfiler(Clock *c) : clock(c), start(0), last(0), count(0), done(false) {}
+
+	void Begin();
+	void Mark(const char *phase);
+
+	// stop taking marks; the total is frozen at the last one
+	void Finish() { done = true; }
+	bool Finished() const { return done; }
+
+	int         Phases() const      { return count; }
+	const char *Name(int i) const   { return phase[i].name; }
+	int64_t     Duration(int i) const { return phase[i].us; }
+	int64_t     Total() const       { return last - start; }
+
+	// budgetus <= 0 means no budget
+	bool OverBudget(int64_t budgetus) const { return budgetus > 0 && Total() > budgetus; }
+
+	//
+	//	A plain text breakdown, a line per phase with its time and share of
+	//	the total, the slowest marked with '*', then a verdict against the
+	//	budget.
+	//
+	void Report(std::string &out, int64_t budgetus) const;
+
+private:
+	struct Phase
+	{
+		const char *name;		//static strings only
+		int64_t     us;
+	};
+
+	Clock  *clock;
+	int64_t start, last;
+	Phase   phase[STARTUP_PHASES];
+	int     count;
+	bool    done;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include <string.h>
+#include "theme.h"
+
+const int LevelGain[MATRIX_BRIGHT + 1] = { 77, 128, 192, 256 };
+
+uint32_t BlipColor(uint32_t c)
+{
+	uint32_t r = (c >> 16) & 0xff, g = (c >> 8) & 0xff, b = c & 0xff;
+	uint32_t m = r > g ? (r > b ? r : b) : (g > b ? g : b);
+
+	r += m / 2; if(r > 255) r = 255;
+	g += m / 2; if(g > 255) g = 255;
+	b += m / 2; if(b > 255) b = 255;
+	return r << 16 | g << 8 | b;
+}
+
+static int Hex(char c)
+{
+	if(c >= '0' && c <= '9') return c - '0';
+	if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static bool Named(const char *name, const char *want)
+{
+	for(; *name && *want; name++, want++)
+		if((*name | 0x20) != *want) return false;
+	return *name == 0 && *want == 0;
+}
+
+bool ParseTheme(const char *name, ColorTheme &theme)
+{
+	if(Named(name, "green"))
+	{
+		theme.color = THEME_GREEN;
+		theme.blip  = BlipColor(theme.color);
+		return true;
+	}
+
+	if(Named(name, "amber"))
+	{
+		theme.color = THEME_AMBER;
+		theme.blip  = BlipColor(theme.color);
+		return true;
+	}
+
+	if(*name == '#') name++;
+	if(strlen(name) != 6) return false;
+
+	uint32_t c = 0;
+	for(int i = 0; i < 6; i++)
+	{
+		int h = Hex(name[i]);
+		if(h < 0) return false;
+		c = c << 4 | h;
+	}
+
+	theme.color = c;
+	theme.blip  = BlipColor(c);
+	return true;
+}
+
+// a scaled by n/d, rounded, channel by channel
+static uint32_t Mix(uint32_t a, int n, int d)
+{
+	uint32_t out = 0;
+	for(int shift = 0; shift < 24; shift += 8)
+		out |= (uint32_t)((((a >> shift) & 0xff) * n + d / 2) / d) << shift;
+	return out;
+}
+
+void ShadeTable::Create(const ColorTheme &theme, int n)
+{
+	if(n < SHADES_MIN) n = SHADES_MIN;
+	if(n > SHADES_MAX) n = SHADES_MAX;
+
+	shades = n;
+
+	int top = n - 2;		//the theme colour; n - 1 is the blip
+	ramp.resize(n);
+	for(int s = 0; s <= top; s++)
+		ramp[s] = Mix(theme.color, s, top);
+	ramp[n - 1] = theme.blip;
+
+	for(int level = 0; level <= MATRIX_BRIGHT; level++)
+		levels[level] = (LevelGain[level] * top + 128) >> 8;
+	levels[MATRIX_BLIP] = n - 1;
+
+	lut.resize((MATRIX_BLIP + 1) * 256);
+	glowlut.resize((MATRIX_BLIP + 1) * 256);
+	for(int level = 0; level <= MATRIX_BLIP; level++)
+		for(int c = 0; c < 256; c++)
+		{
+			int s = (levels[level] * c + 127) / 255;
+			lut[(size_t)level * 256 + c]     = ramp[s];
+			glowlut[(size_t)level * 256 + c] = (uint8_t)((s * 255 + (n - 1) / 2) / (n - 1));
+		}
+
+	//each shade's glow rounds back to that shade
+	glowcolor.resize(256);
+	for(int v = 0; v < 256; v++)
+		glowcolor[v] = ramp[(v * (n - 1) + 127) / 255];
+}
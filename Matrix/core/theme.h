@@ -0,0 +1,92 @@
+#ifndef MATRIX_THEME_INC
+#define MATRIX_THEME_INC
+
+#include <stdint.h>
+#include <vector>
+#include "engine.h"
+
+#define SHADES_MIN		16		//steps from black to the theme colour
+#define SHADES_MAX		64
+#define SHADES_DEFAULT	32
+
+#define THEME_GREEN		0x70cc6d	//matrix.bmp's brightest digits
+#define THEME_AMBER		0xffb000
+
+//
+//	Colours for the rain, 0x00RRGGBB: the colour of a bright digit and the
+//	colour of the blip.
+//
+struct ColorTheme
+{
+	uint32_t color;
+	uint32_t blip;
+};
+
+// out of 256: each intensity's brightness against MATRIX_BRIGHT, measured from matrix.bmp
+extern const int LevelGain[MATRIX_BRIGHT + 1];
+
+// every channel lifted by half the brightest one, as matrix.bmp's blip row is
+uint32_t BlipColor(uint32_t c);
+
+//
+//	"green", "amber", or a colour of its own as RRGGBB or #RRGGBB (the blip
+//	is then the colour pushed towards white). Case is ignored. False for
+//	anything else, leaving theme alone.
+//
+bool ParseTheme(const char *name, ColorTheme &theme);
+
+//
+//	A theme spread over a ramp of shades: shade 0 is black, the ramp rises
+//	evenly to the theme colour at Shades() - 2, and the last shade is the
+//	blip. Each engine intensity (0..MATRIX_BRIGHT, and MATRIX_BLIP) sits
+//	at a fixed shade, and gets a 256-entry LUT from glyph coverage to
+//	colour: a pixel covered c/255 of the way is that shade scaled by c,
+//	rounded to the ramp.
+//
+//	For the afterglow the same shades are also spread over 0..255: a glow
+//	LUT per level gives coverage to glow, and GlowColors turns any glow
+//	back into the colour of the nearest shade, so a fading pixel steps
+//	down the ramp one shade at a time.
+//
+//	The engine still has only MATRIX_BRIGHT + 1 intensities (LevelGain),
+//	so a trail steps through four shades however many there are. The
+//	rest of the ramp is only reached by anti-aliased glyph edges and by
+//	the afterglow's fade; without an afterglow, more shades just mean
+//	smoother edges.
+//
+//	Everything is worked out once in Create; the LUTs are what
+//	BuildThemeAtlas and BuildGlowAtlas bake into their atlases.
+//
+class ShadeTable
+{
+public:
+	ShadeTable() : shades(0) {}
+
+	// shades is clamped to SHADES_MIN..SHADES_MAX
+	void Create(const ColorTheme &theme, int shades);
+
+	int  Shades() const { return shades; }
+	uint32_t Shade(int s) const { return ramp[s]; }
+
+	// the shade of intensity level (0..MATRIX_BLIP) at full coverage
+	int  LevelShade(int level) const { return levels[level]; }
+
+	// coverage 0..255 to colour, for intensity level
+	const uint32_t *Lut(int level) const { return &lut[(size_t)level * 256]; }
+
+	// coverage 0..255 to glow 0..255, for intensity level
+	const uint8_t  *GlowLut(int level) const { return &glowlut[(size_t)level * 256]; }
+
+	// glow 0..255 to colour
+	const uint32_t *GlowColors() const { return &glowcolor[0]; }
+
+private:
+	int shades;
+	int levels[MATRIX_BLIP + 1];
+	std::vector<uint32_t> ramp;
+	std::vector<uint32_t> lut;
+	std::vector<uint8_t>  glowlut;
+	std::vector<uint32_t> glowcolor;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "threadpool.h"
+
+static inline uint64_t Pack(uint32_t next, uint32_t end)
+{
+	return ((uint64_t)end << 32) | next;
+}
+
+ThreadPool::ThreadPool(int threads)
+	: slots(0), nslots(0), generation(0), finished(0), quit(false), jobfn(0), jobctx(0)
+{
+	if(threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+
+	if(threads <= 0)
+		threads = 1;
+
+	nslots = threads;
+	slots  = new Slot[nslots];
+
+	for(int i = 0; i < nslots; i++)
+		slots[i].range.store(0);
+
+	//slot 0 belongs to whoever calls ParallelFor
+	for(int i = 1; i < nslots; i++)
+		workers.push_back(std::thread(&ThreadPool::Worker, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> g(lock);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	delete[] slots;
+}
+
+void ThreadPool::ParallelFor(int count, void (*fn)(void *ctx, int i), void *ctx)
+{
+	if(count <= 0)
+		return;
+
+	if(nslots == 1 || count == 1)
+	{
+		for(int i = 0; i < count; i++) fn(ctx, i);
+		return;
+	}
+
+	for(int i = 0; i < nslots; i++)
+	{
+		uint32_t lo = (uint32_t)((int64_t)count * i / nslots);
+		uint32_t hi = (uint32_t)((int64_t)count * (i + 1) / nslots);
+		slots[i].range.store(Pack(lo, hi));
+	}
+
+	{
+		std::lock_guard<std::mutex> g(lock);
+		jobfn = fn;
+		jobctx = ctx;
+		finished = 0;
+		generation++;
+	}
+	wake.notify_all();
+
+	Drain(0);
+
+	//every worker has to report in, so none is still inside this job
+	std::unique_lock<std::mutex> g(lock);
+	done.wait(g, [this] { return finished == nslots - 1; });
+}
+
+void ThreadPool::Worker(int id)
+{
+	unsigned seen = 0;
+
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> g(lock);
+			wake.wait(g, [&] { return quit || generation != seen; });
+			if(quit) return;
+			seen = generation;
+		}
+
+		Drain(id);
+
+		{
+			std::lock_guard<std::mutex> g(lock);
+			if(++finished == nslots - 1) done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::Drain(int id)
+{
+	do
+	{
+		int i;
+		while(PopFront(id, i))
+			jobfn(jobctx, i);
+	}
+	while(Steal(id));
+}
+
+bool ThreadPool::PopFront(int id, int &i)
+{
+	uint64_t r = slots[id].range.load();
+
+	for(;;)
+	{
+		uint32_t next = (uint32_t)r, end = (uint32_t)(r >> 32);
+		if(next >= end) return false;
+
+		if(slots[id].range.compare_exchange_weak(r, Pack(next + 1, end)))
+		{
+			i = (int)next;
+			return true;
+		}
+	}
+}
+
+bool ThreadPool::Steal(int id)
+{
+	for(int k = 1; k < nslots; k++)
+	{
+		Slot &victim = slots[(id + k) % nslots];
+		uint64_t r = victim.range.load();
+
+		for(;;)
+		{
+			uint32_t next = (uint32_t)r, end = (uint32_t)(r >> 32);
+			if(next >= end) break;
+
+			//take the back half, leaving the victim its front
+			uint32_t mid = end - (end - next + 1) / 2;
+
+			if(victim.range.compare_exchange_weak(r, Pack(next, mid)))
+			{
+				slots[id].range.store(Pack(mid, end));
+				return true;
+			}
+		}
+	}
+	return false;
+}
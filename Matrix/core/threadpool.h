@@ -0,0 +1,67 @@
+#ifndef MATRIX_THREADPOOL_INC
+#define MATRIX_THREADPOOL_INC
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+//	A fixed pool of worker threads for data-parallel loops.
+//
+//	ParallelFor hands each thread (the caller included) an even share of
+//	the index range. A thread that runs out of work steals the back half
+//	of whatever another thread has left, so uneven items still balance.
+//	Items must not depend on which thread runs them, or in what order.
+//
+class ThreadPool
+{
+public:
+	// threads counts the calling thread; <= 0 means one per hardware thread
+	explicit ThreadPool(int threads);
+	~ThreadPool();
+
+	int Threads() const { return nslots; }
+
+	// call fn(ctx, i) for every i in [0, count) and wait for them all
+	void ParallelFor(int count, void (*fn)(void *ctx, int i), void *ctx);
+
+	template<class F> void ParallelFor(int count, F &f)
+	{
+		ParallelFor(count, &Trampoline<F>, &f);
+	}
+
+private:
+	template<class F> static void Trampoline(void *ctx, int i) { (*(F *)ctx)(i); }
+
+	// each thread's remaining range: low 32 bits next, high 32 bits end
+	struct Slot
+	{
+		std::atomic<uint64_t> range;
+		char pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	void Worker(int id);
+	void Drain(int id);
+	bool PopFront(int id, int &i);
+	bool Steal(int id);
+
+	Slot *slots;
+	int   nslots;
+
+	std::vector<std::thread> workers;
+
+	std::mutex lock;
+	std::condition_variable wake;		//a new job, or quit
+	std::condition_variable done;		//a worker finished the current job
+	unsigned generation;
+	int      finished;
+	bool     quit;
+
+	void (*jobfn)(void *, int);
+	void  *jobctx;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include <stddef.h>
+#include "wheel.h"
+
+void TimingWheel::Clear()
+{
+	for(int i = 0; i < WHEEL_SLOTS; i++)
+		slot[i].clear();
+}
+
+void TimingWheel::Add(uint32_t due, uint32_t code)
+{
+	Event e = { due, code };
+	slot[due & (WHEEL_SLOTS - 1)].push_back(e);
+}
+
+void TimingWheel::Pop(uint32_t now, std::vector<uint32_t> &out)
+{
+	std::vector<Event> &s = slot[now & (WHEEL_SLOTS - 1)];
+
+	size_t keep = 0;
+	for(size_t i = 0; i < s.size(); i++)
+	{
+		if(s[i].due == now)
+			out.push_back(s[i].code);
+		else
+			s[keep++] = s[i];
+	}
+
+	s.resize(keep);
+}
@@ -0,0 +1,39 @@
+#ifndef MATRIX_WHEEL_INC
+#define MATRIX_WHEEL_INC
+
+#include <stdint.h>
+#include <vector>
+
+#define WHEEL_SLOTS 256			//power of two; longer delays just wait for another lap
+
+//
+//	A timing wheel of events keyed by tick number. Add files an event in
+//	the slot for its tick; Pop hands back everything due on one tick and
+//	leaves events for later laps where they are. Adding and popping are
+//	O(1) per event, so a tick costs nothing for anything not due on it.
+//
+//	There is no cancel: owners record the tick they expect and ignore
+//	events that no longer match it.
+//
+class TimingWheel
+{
+public:
+	void Clear();
+
+	// due must be after the last tick popped
+	void Add(uint32_t due, uint32_t code);
+
+	// append the codes of the events due on tick now, in the order added
+	void Pop(uint32_t now, std::vector<uint32_t> &out);
+
+private:
+	struct Event
+	{
+		uint32_t due;
+		uint32_t code;
+	};
+
+	std::vector<Event> slot[WHEEL_SLOTS];
+};
+
+#endif
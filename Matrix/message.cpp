@@ -1,48 +1,100 @@
 #include <windows.h>
 #include "message.h"
 #include "matrix.h"
+#include "core/drawlist.h"
+#include "core/msgmask.h"
+#include "core/feed.h"
+#include <algorithm>
+#include <tchar.h>
 
 static HDC hdcMessage;
 static HBITMAP hBitmapMsg;
 static HANDLE hdcold;
+static uint32_t *msgbits;		//hBitmapMsg's pixels, top-down, msgwidth per row
+static int msgwidth, msgheight;		//of hBitmapMsg, a pixel per cell and three screens tall
 
 extern int numrows, numcols;
-extern int jjrand();
-extern int xChar, yChar;
-extern HDC hdcSymbols;
+extern int maxrows, maxcols;
 extern int MessageSpeed;
 extern BOOL RandomizeMessages;
 extern BOOL FontBold;
 extern int FontSize;
 extern Message message;
 extern TCHAR szFontName[];
+
+TCHAR szMaskCachePath[MAX_PATH];
+TCHAR szFeedPath[MAX_PATH];
+
+//live lines from szFeedPath; the next one to show waits in szLive
+static MessageFeed feed;
+static TCHAR szLive[MAXMSGLEN];
+static bool  havelive;
+
+static FILE *OpenFeed(void *)
+{
+	return _tfopen(szFeedPath, _T("rb"));
+}
 //
 //	A class which handles matrix messages appearing
 //
 
 Message::Message()
+	: sorted(0), revealed(0), revealtick(0)
 {
-	HideMessage();
 }
 
-int Message::rand()
-{ 
-	static unsigned short reg = (unsigned short)(GetTickCount() & 0xffff);
-	unsigned short mask = 0xb400;
-
-	if(reg & 1)
-		reg = (reg >> 1) ^ mask;
-	else 
-		reg = (reg >> 1);
-
-	return reg;
+//
+//	Cells are kept as 16-bit coordinates, which is 65535 columns of even
+//	the narrowest glyphs: far more than any desktop.
+//
+void Message::Create(int cols, int rows)
+{
+	if(cols > 0xffff) cols = 0xffff;
+	if(rows > 0xffff) rows = 0xffff;
+
+	bitmap.Create(cols, rows);
+	visible.Create(cols, rows);
+	shown.clear();
+	sorted = 0;
+	order.clear();
+	revealed = revealtick = 0;
 }
 
 void InitMessage(void)
 {
+	message.rng.Seed(GetTickCount());
+
+	if(szFeedPath[0])
+		feed.Start(OpenFeed, 0);
+
+	//everything grid-sized follows the desktop the saver covers
+	message.Create(maxcols, maxrows);
+	msgwidth  = message.bitmap.Width();
+	msgheight = message.bitmap.Height() * 3;
+
+	if(szMaskCachePath[0])
+	{
+		FILE *fp = _tfopen(szMaskCachePath, _T("rb"));
+		if(fp)
+		{
+			message.masks.Read(fp);
+			fclose(fp);
+		}
+	}
+
+	//a 32bpp top-down DIB section, so the text can be read back from memory
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(bmi));
+	bmi.bmiHeader.biSize        = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth       = msgwidth;
+	bmi.bmiHeader.biHeight      = -msgheight;
+	bmi.bmiHeader.biPlanes      = 1;
+	bmi.bmiHeader.biBitCount    = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
 	HDC hdc = GetDC(0);
 	hdcMessage = CreateCompatibleDC(hdc);
-	hBitmapMsg = CreateCompatibleBitmap(hdc, MSGWIDTH, MSGHEIGHT*3);
+	hBitmapMsg = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (void **)&msgbits, 0, 0);
 	hdcold = SelectObject(hdcMessage, hBitmapMsg);
 
 	ReleaseDC(0, hdc);
@@ -50,6 +102,19 @@ void InitMessage(void)
 
 void DeInitMessage(void)
 {
+	feed.Stop();
+	havelive = false;
+
+	if(szMaskCachePath[0] && message.masks.Changed())
+	{
+		FILE *fp = _tfopen(szMaskCachePath, _T("wb"));
+		if(fp)
+		{
+			message.masks.Write(fp);
+			fclose(fp);
+		}
+	}
+
 	SelectObject(hdcMessage, hdcold);
 	DeleteObject(hBitmapMsg);
 	DeleteDC	(hdcMessage);
@@ -57,18 +122,79 @@ void DeInitMessage(void)
 
 void Message::HideMessage()
 {
-	for(int x = 0; x < MSGWIDTH; x++)
-		for(int y = 0; y < MSGHEIGHT; y++)
-			visible[x][y] = false;
+	visible.Clear();
+	shown.clear();
+	sorted = 0;
+	revealed = revealtick = 0;
 }
 
 void Message::ClearMessage()
 {
-	for(int x = 0; x < MSGWIDTH; x++)
-		for(int y = 0; y < MSGHEIGHT; y++)
-			bitmap[x][y] = false;
+	bitmap.Clear();
+	shown.clear();
+	sorted = 0;
+	order.clear();
+	revealed = revealtick = 0;
 }
 
+// a fresh reveal order: every lit cell once, shuffled (Fisher-Yates)
+void Message::Shuffle()
+{
+	order.clear();
+
+	for(int y = 0; y < bitmap.Height(); y++)
+	{
+		const uint64_t *b = bitmap.Row(y);
+		for(int w = 0; w < bitmap.Words(); w++)
+			for(uint64_t m = b[w]; m; m &= m - 1)
+				order.push_back((uint32_t)(w * 64 + Ctz64(m)) << 16 | y);
+	}
+
+	for(int i = (int)order.size() - 1; i > 0; i--)
+		std::swap(order[i], order[rng.Below(i + 1)]);
+
+	revealed = revealtick = 0;
+}
+
+// a lit cell has just become visible
+void Message::Show(int x, int y)
+{
+	LitCell c = { (uint16_t)x, (uint16_t)y, (uint16_t)rng.Below(engine.NumGlyphs()), 1 };
+	shown.push_back(c);
+}
+
+// shown from scratch, for when the bitmap changes under the visible cells
+void Message::RebuildShown()
+{
+	shown.clear();
+	sorted = 0;
+
+	for(int y = 0; y < bitmap.Height(); y++)
+	{
+		const uint64_t *b = bitmap.Row(y), *v = visible.Row(y);
+		for(int w = 0; w < bitmap.Words(); w++)
+			for(uint64_t m = b[w] & v[w]; m; m &= m - 1)
+				Show(w * 64 + Ctz64(m), y);
+	}
+}
+
+// everything the rasterized mask depends on
+static std::string MaskKey(const TCHAR *msg, int lfHeight)
+{
+	int params[] = { lfHeight, FontBold ? 1 : 0, numcols, message.bitmap.Width(), message.bitmap.Height() };
+
+	std::string key((const char *)msg, lstrlen(msg) * sizeof(TCHAR));
+	key.append(1, '\0');
+	key.append((const char *)szFontName, lstrlen(szFontName) * sizeof(TCHAR));
+	key.append(1, '\0');
+	key.append((const char *)params, sizeof(params));
+	return key;
+}
+
+//
+//	Rasterize the message into bitmap, or fetch it from the mask cache
+//	when this text has been drawn before with the same font and grid.
+//
 void Message::SetMessage(TCHAR *newmsg, int PointSize)
 {
 	RECT rect;
@@ -83,40 +209,39 @@ void Message::SetMessage(TCHAR *newmsg, int PointSize)
 
 	lstrcpy(curmsg, newmsg);
 
+	std::string key = MaskKey(newmsg, lfHeight);
+
+	if(masks.Get(key, bitmap))
+	{
+		RebuildShown();
+		Shuffle();
+		ReleaseDC(0, hdc);
+		return;
+	}
+
+	//no scratch bitmap (too big for GDI), so no message
+	if(msgbits == 0)
+	{
+		ReleaseDC(0, hdc);
+		return;
+	}
+
 	hfont = (HFONT)CreateFont(lfHeight, 0, 0, 0, 
 		FontBold ? FW_BOLD: FW_NORMAL, 0, 0, 0, ANSI_CHARSET, OUT_DEFAULT_PRECIS,
 		CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY, DEFAULT_PITCH, szFontName);
 
-	SetRect(&rect, 0, 0, numcols,MSGHEIGHT*3);
+	SetRect(&rect, 0, 0, min(numcols, msgwidth), msgheight);
 	holdfont = (HFONT)SelectObject(hdcMessage, hfont);
 	
 	FillRect(hdcMessage, &rect, (HBRUSH)GetStockObject(WHITE_BRUSH));
 	height = DrawText(hdcMessage, newmsg, lstrlen(newmsg), &rect, DT_CENTER | DT_VCENTER | DT_WORDBREAK);
 
-	int curline = 0;
-	bool lastempty = true;
-	int start = -1;
-
-	for(int y = 0; y < height; y++)
-	{
-		bool empty = true;
-
-		for(int x = 0; x < numcols; x++)
-		{
-			if(GetPixel(hdcMessage, x, y) < RGB(96,96,96))
-			{
-				if(start == -1) { curline = y; start = y; }
-				bitmap[x][curline] = true;
-				empty = false;
-			}
-			else
-				bitmap[x][curline] = false;
-
-		}
-
-		if(!empty || empty && !lastempty) curline++;
-		lastempty = empty;
-	}
+	//threshold straight from the DIB bits instead of a GetPixel per pixel
+	GdiFlush();
+	BuildMessageMask(msgbits, msgwidth, min(numcols, msgwidth), min(height, msgheight), bitmap);
+	masks.Put(key, bitmap);
+	RebuildShown();
+	Shuffle();
 
 	SelectObject(hdcMessage, holdfont);
 	DeleteObject(hfont);
@@ -126,28 +251,73 @@ void Message::SetMessage(TCHAR *newmsg, int PointSize)
 
 
 
-void Message::ShowMessage(HDC hdc)
+static bool ColumnOrder(const Message::LitCell &a, const Message::LitCell &b)
 {
-	for(int x = 0; x < numcols; x++)
+	return a.x != b.x ? a.x < b.x : a.y < b.y;
+}
+
+//
+//	Add the message to the frame's draw list, over the rain. Only cells
+//	that need it are drawn: ones just revealed, ones the rain has drawn
+//	over this frame, and the MessageShimmer percent picked to change glyph.
+//	Call before the engine's dirty cells are cleared.
+//
+void Message::ShowMessage(DrawList &list)
+{
+	int n = (int)shown.size();
+	if(n == 0) return;
+
+	//the draw list wants column order: sort just the cells revealed since
+	//last time and merge them in
+	if(sorted < shown.size())
 	{
-		for(int y = 0; y < numrows; y++)
-		{
-			int c = jjrand() % 26;
-			
-			if(bitmap[x][y] == true && visible[x][y])
-			{
-				BitBlt(hdc, x*xChar, y*yChar, 14, 14, hdcSymbols, c*14,14*4, SRCCOPY);
-			}
-		}
+		std::sort(shown.begin() + sorted, shown.end(), ColumnOrder);
+		std::inplace_merge(shown.begin(), shown.begin() + sorted, shown.end(), ColumnOrder);
+		sorted = shown.size();
+	}
+
+	for(int k = n * MessageShimmer / 100; k > 0; k--)
+	{
+		LitCell &c = shown[rng.Below(n)];
+		c.glyph  = (uint16_t)rng.Below(engine.NumGlyphs());
+		c.redraw = 1;
+	}
+
+	for(int i = 0; i < n; i++)
+	{
+		LitCell &c = shown[i];
+
+		if(c.x >= numcols || c.y >= numrows)
+			continue;
+
+		if(c.redraw || engine.IsDirty(c.x, c.y))
+			list.Overlay(c.x, c.y, MATRIX_BLIP * engine.NumGlyphs() + c.glyph);
+
+		c.redraw = 0;
 	}
 }
 
-void Message::Reveal(int amt)
+//
+//	Make the next share of the message visible, so that every lit cell is
+//	showing after ticks calls. Each call reveals cells that weren't visible
+//	yet, straight from the shuffled order.
+//
+void Message::Reveal(int ticks)
 {
-	for(int k = 0; k < amt; k++)
+	int n = (int)order.size();
+
+	if(ticks < 1) ticks = 1;
+
+	int target = ++revealtick >= ticks ? n : (int)((int64_t)n * revealtick / ticks);
+
+	for(; revealed < target; revealed++)
 	{
-		int pos = rand() & 0xffff;
-		visible[pos / 256][pos % 256] = true;
+		int x = order[revealed] >> 16, y = order[revealed] & 0xffff;
+
+		if(visible.Test(x, y)) continue;
+
+		visible.Set(x, y);
+		Show(x, y);
 	}
 }
 
@@ -158,7 +328,7 @@ void Message::Preview(HDC hdc)
 		for(int y = 0; y < numrows; y++)
 		{
 			COLORREF col;
-			if(bitmap[x][y] == true)
+			if(x < bitmap.Width() && y < bitmap.Height() && bitmap.Test(x, y))
 			{
 				col = RGB(128,255,128);
 			}
@@ -172,9 +342,10 @@ void Message::Preview(HDC hdc)
 }
 
 //
-//	Called for each iteration of the display
+//	Called once per simulation step, to advance the message cycle. A line
+//	from the feed, when there is one, goes ahead of the configured messages.
 //
-void DoMessages(HDC hdc)
+void StepMessages(void)
 {
 	static int nCurrentMessage = -1;
 
@@ -182,7 +353,7 @@ void DoMessages(HDC hdc)
 	//
 	int RealSpeed = (MSGSPEED_MAX-MSGSPEED_MIN) - (MessageSpeed-MSGSPEED_MIN) + MSGSPEED_MIN;
 
-	if(nNumMessages > 0)
+	if(nNumMessages > 0 || feed.Running())
 	{
 		//start off showing nothing
 		static int burncounter = RealSpeed / 2;
@@ -194,33 +365,68 @@ void DoMessages(HDC hdc)
 		
 		if(burncounter == RealSpeed)
 		{
-			//reset the message counter, and display a new message!!
-			if(RandomizeMessages)
-				nCurrentMessage = jjrand() % nNumMessages;
+			if(havelive)
+			{
+				message.SetMessage(szLive, FontSize);
+				havelive = false;
+			}
+			else if(nNumMessages > 0)
+			{
+				//reset the message counter, and display a new message!!
+				if(RandomizeMessages)
+					nCurrentMessage = message.rng.Below(nNumMessages);
+				else
+					if(++nCurrentMessage >= nNumMessages) nCurrentMessage = 0;
+
+				message.SetMessage(szMessages[nCurrentMessage], FontSize);
+			}
 			else
-				if(++nCurrentMessage >= nNumMessages) nCurrentMessage = 0;
-				
-			message.SetMessage(szMessages[nCurrentMessage], FontSize);
+			{
+				//a quiet feed and nothing configured
+				message.ClearMessage();
+			}
 			burncounter = 0;
 		}
 		
+		//fully formed for the second half of its time on screen
 		if(burncounter < RealSpeed / 2)
+			message.Reveal(RealSpeed / 4);
+	}
+}
+
+//
+//	Called for each frame presented, once the matrix is in the draw list
+//	and before its dirty cells are cleared. Takes a line from the feed
+//	only when the last one has been shown, and gets the newest: any that
+//	came in while it was up are passed over.
+//
+void DoMessages(DrawList &list)
+{
+	FeedLine line;
+
+	if(!havelive && feed.TryPop(line))
+	{
+#ifdef UNICODE
+		WCHAR wide[FEED_LINELEN];
+		if(MultiByteToWideChar(CP_UTF8, 0, line.text, -1, wide, FEED_LINELEN))
 		{
-//			float a,b;
-//			b = MessageSpeed - MSGSPEED_MIN;
-//			b = 1+b/MSGSPEED_MAX;
-//			a = float(MessageSpeed) * b * 3;
-			int w = (MessageSpeed - MSGSPEED_MIN);
-			w = (1 << 16) + ((w<<16) / MSGSPEED_MAX);
-			w = (w * 3 * MessageSpeed) >> 16;
-
-			message.Reveal(w + 100);
+			lstrcpyn(szLive, wide, MAXMSGLEN);
+			havelive = true;
 		}
-		
-		message.ShowMessage(hdc);
+#else
+		lstrcpyn(szLive, line.text, MAXMSGLEN);
+		havelive = true;
+#endif
 	}
 
-//	SelectObject(hdc, GetStockObject(WHITE_PEN));
-//	Rectangle(hdc, 0, 0, maxcols, maxrows);
-//	BitBlt(hdc, 0, 0, maxcols, maxrows, hdcMessage, 0, 0, SRCCOPY);
-}
\ No newline at end of file
+	if(nNumMessages > 0 || feed.Running())
+		message.ShowMessage(list);
+}
+
+// false when there is no feed
+bool MessageFeedStats(unsigned &lines, unsigned &dropped)
+{
+	lines   = feed.Lines();
+	dropped = feed.Dropped();
+	return feed.Running();
+}
@@ -1,13 +1,21 @@
 #ifndef _MSGINC
 #define _MSGINC
 
+#include "core/rng.h"
+#include "core/bitmatrix.h"
+#include "core/maskcache.h"
+#include <vector>
+
+class DrawList;
+
 #define MAXMESSAGES 16
 #define MAXMSGLEN 64
-#define MSGWIDTH  256
-#define MSGHEIGHT 256
 
 extern int nNumMessages;
+extern int MessageShimmer;
 extern TCHAR szMessages[][MAXMSGLEN];
+extern TCHAR szMaskCachePath[];		//file the mask cache persists to, empty for none
+extern TCHAR szFeedPath[];			//log file or pipe to show lines from, empty for none
 
 //
 //	A class which handles matrix messages appearing
@@ -17,26 +25,55 @@ class Message
 public:
 	TCHAR curmsg[MAXMSGLEN];
 
-	bool bitmap[MSGWIDTH][MSGHEIGHT];
-	bool visible[MSGWIDTH][MSGHEIGHT];
+	BitMatrix bitmap;		//cells of the message text, one bit per grid cell
+	BitMatrix visible;		//cells revealed so far
+
+	//the cells that are both lit and visible, kept up to date by Reveal
+	struct LitCell
+	{
+		uint16_t x, y;
+		uint16_t glyph;
+		uint8_t  redraw;	//changed since it was last drawn
+	};
+	std::vector<LitCell> shown;
+	size_t sorted;			//cells at the front of shown that are in column order
+
+	//the lit cells in a random order, x << 16 | y; Reveal works through it
+	std::vector<uint32_t> order;
+	int revealed;			//cells of order made visible so far
+	int revealtick;			//Reveal calls since the message was set
 
 	bool state;
 
-	Message();
+	Rng rng;		//seeded by InitMessage
 
+	MaskCache masks;	//rasterized messages, see SetMessage
 
-	int rand();//unsigned short reg) 
+	Message();
+
+	// size the masks for a grid of cols x rows cells, and clear them
+	void Create(int cols, int rows);
 
 	void SetMessage(TCHAR *newmsg, int fontsize);
-	void Reveal(int amt);
-	void ShowMessage(HDC hdc);
+	void Reveal(int ticks);
+	void ShowMessage(DrawList &list);
 	void HideMessage(void);
 	void ClearMessage(void);
 	void Preview(HDC hdc);
+
+	int  Lit(void) const      { return bitmap.Count(); }
+	int  Revealed(void) const { return BitMatrix::CountAnd(bitmap, visible); }
+
+private:
+	void Show(int x, int y);
+	void RebuildShown(void);
+	void Shuffle(void);
 };
 
 void InitMessage(void);
 void DeInitMessage(void);
-void DoMessages(HDC hdc);
+void StepMessages(void);
+void DoMessages(DrawList &list);
+bool MessageFeedStats(unsigned &lines, unsigned &dropped);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "core/afterglow.h"
+#include "core/drawlist.h"
+#include "core/engine.h"
+#include "core/rng.h"
+#include "core/simd.h"
+#include "core/threadpool.h"
+
+#define GLYPHS 5
+#define SPARE  0xdeadbeef		//framebuffer pixels past the width, never written
+
+// a glow atlas with gaps between the strokes, GLYPHS across, a row of cells per intensity
+static std::vector<uint8_t> Atlas(int cellw, int cellh, Rng &rng)
+{
+	std::vector<uint8_t> a((size_t)GLYPHS * cellw * (MATRIX_BLIP + 1) * cellh);
+	for(size_t i = 0; i < a.size(); i++)
+		a[i] = rng.Below(3) ? 0 : (uint8_t)(1 + rng.Below(255));
+	return a;
+}
+
+//
+//	The afterglow with nothing skipped: every pixel of the grid is decayed
+//	every frame, every glyph cell blended back in, and every pixel coloured.
+//
+struct Reference
+{
+	int width, height, cellw, cellh, cols, rows, keep;
+	const std::vector<uint8_t> *atlas;
+	std::vector<uint8_t>  glow;
+	std::vector<uint16_t> target;
+	std::vector<uint32_t> pixels;
+
+	Reference(int w, int h, int cw, int ch, int k, const std::vector<uint8_t> &a)
+		: width(w), height(h), cellw(cw), cellh(ch), keep(k), atlas(&a)
+	{
+		cols = (w + cw - 1) / cw;
+		rows = (h + ch - 1) / ch;
+		glow.assign((size_t)cols * cw * rows * ch, 0);
+		target.assign((size_t)cols * rows, GLOW_BLANK);
+		pixels.assign((size_t)w * h, 0);
+	}
+
+	// returns the tiles Afterglow should have worked on: glowing before, or under a glyph now
+	int Draw(const DrawList &list, const uint32_t *colors)
+	{
+		for(int i = 0; i < list.Size(); i++)
+		{
+			const DrawCmd &c = list[i];
+			for(int k = 0; k < c.count && c.x < cols && c.y + k < rows; k++)
+				target[(size_t)(c.y + k) * cols + c.x] = c.op == DRAW_BLIT ? list.Cells()[c.first + k] : GLOW_BLANK;
+		}
+
+		int gw = cols * cellw, across = GLYPHS * cellw;
+		int tiles = 0;
+
+		for(int b = 0; b < rows; b++)
+			for(int t = 0; t * GLOW_TILE < gw; t++)
+			{
+				bool need = false;
+				for(int y = b * cellh; y < (b + 1) * cellh; y++)
+					for(int x = t * GLOW_TILE; x < (t + 1) * GLOW_TILE && x < gw; x++)
+						need |= glow[(size_t)y * gw + x] != 0;
+				for(int x = 0; x < cols; x++)
+					if(target[(size_t)b * cols + x] != GLOW_BLANK)
+						need |= x * cellw / GLOW_TILE <= t && t <= (x * cellw + cellw - 1) / GLOW_TILE;
+				tiles += need;
+			}
+
+		for(size_t i = 0; i < glow.size(); i++)
+			glow[i] = (uint8_t)(glow[i] * keep >> 8);
+
+		for(int cy = 0; cy < rows; cy++)
+			for(int cx = 0; cx < cols; cx++)
+			{
+				int cell = target[(size_t)cy * cols + cx];
+				if(cell == GLOW_BLANK) continue;
+
+				int level = cell / GLYPHS, g = cell % GLYPHS;
+				for(int y = 0; y < cellh; y++)
+					for(int x = 0; x < cellw; x++)
+					{
+						uint8_t a = (*atlas)[(size_t)(level * cellh + y) * across + g * cellw + x];
+						uint8_t &d = glow[(size_t)(cy * cellh + y) * gw + cx * cellw + x];
+						if(a > d) d = a;
+					}
+			}
+
+		for(int y = 0; y < height; y++)
+			for(int x = 0; x < width; x++)
+				pixels[(size_t)y * width + x] = colors[glow[(size_t)y * gw + x]];
+
+		return tiles;
+	}
+};
+
+//
+//	Every decay kernel, with and without a pool, against the reference
+//	frame by frame. The rain is sparse, so tiles go dark and are skipped
+//	while their neighbours still glow.
+//
+static void Matches(int cellw, int cellh, int width, int height, int keep, uint64_t seed)
+{
+	Rng rng(seed);
+	std::vector<uint8_t> atlas = Atlas(cellw, cellh, rng);
+
+	ColorTheme theme;
+	ParseTheme("green", theme);
+	ShadeTable shades;
+	shades.Create(theme, 32);
+
+	int cols = (width + cellw - 1) / cellw, rows = (height + cellh - 1) / cellh;
+	int pitch = width + 5;
+
+	MatrixEngine e;
+	e.SetGlyphs(GLYPHS);
+	e.Create(cols + 1, rows + 1, 8, seed);
+	e.Resize(cols, rows);
+
+	const int levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AUTO };
+	ThreadPool pool2(2), pool3(3);
+	ThreadPool *pools[] = { 0, &pool2, &pool3, 0 };
+
+	Afterglow glow[4];
+	std::vector<uint32_t> fb[4];
+	for(int i = 0; i < 4; i++)
+	{
+		CHECK(glow[i].SetAtlas(atlas, GLYPHS, cellw, cellh, shades));
+		glow[i].Create(width, height);
+		glow[i].SetKeep(keep);
+		glow[i].SetKernel(levels[i]);
+		fb[i].assign((size_t)pitch * height, SPARE);
+		for(int y = 0; y < height; y++)
+			memset(&fb[i][(size_t)y * pitch], 0, width * sizeof(uint32_t));
+	}
+
+	Reference ref(width, height, cellw, cellh, keep, atlas);
+	DrawList list;
+	bool skipped = false;
+
+	//tiles in every band, as Afterglow::Create lays them out
+	int all = rows * ((cols * cellw + ((cellw + 15) & ~15) + GLOW_TILE - 1) / GLOW_TILE);
+
+	for(int t = 0; t < 160; t++)
+	{
+		//the rain stops halfway; cells it left glyphs on keep them, the rest fade
+		if(t < 80)
+		{
+			e.Step();
+			list.Build(e);
+			e.ClearDirty();
+
+			//a few message glyphs early on
+			if(t < 20)
+				for(int x = t % 4; x < cols; x += 9)
+					list.Overlay(x, t % rows, MATRIX_BLIP * GLYPHS + x % GLYPHS);
+		}
+		else
+			list = DrawList();
+
+		int tiles = ref.Draw(list, shades.GlowColors());
+
+		for(int i = 0; i < 4; i++)
+		{
+			std::vector<uint32_t> before = fb[i];
+			glow[i].Draw(list, &fb[i][0], pitch, pools[i]);
+
+			int bad = 0, spare = 0, outside = 0;
+			for(int y = 0; y < height; y++)
+			{
+				int x0 = 0, x1 = 0;
+				glow[i].Changed(y / cellh, x0, x1);
+
+				for(int x = 0; x < pitch; x++)
+				{
+					size_t at = (size_t)y * pitch + x;
+					if(x >= width)                          spare += fb[i][at] != SPARE;
+					else if(fb[i][at] != ref.pixels[(size_t)y * width + x]) bad++;
+					else if(fb[i][at] != before[at] && (x < x0 || x >= x1)) outside++;
+				}
+			}
+
+			if(bad || spare || outside || glow[i].Tiles() != tiles)
+			{
+				fprintf(stderr, "%dx%d cells, %dx%d, keep %d, %s: frame %d: %d wrong, %d past the width, %d outside Changed, %d tiles for %d\n",
+				        cellw, cellh, width, height, keep, SimdName(SimdResolve(levels[i])), t, bad, spare, outside, glow[i].Tiles(), tiles);
+				CHECK(false);
+				return;
+			}
+		}
+
+		if(tiles > 0 && tiles < all) skipped = true;
+	}
+
+	//tiles were left out along the way, not just worked on or not
+	CHECK(skipped);
+}
+
+int main()
+{
+	printf("kernels: scalar, %s, %s\n", SimdName(SimdResolve(SIMD_SSE2)), SimdName(SimdResolve(SIMD_AVX2)));
+
+	Matches(14, 14, 640, 300, 200, 1);
+	Matches(14, 14, 641, 303, 128, 2);		//partial cells on the right and bottom
+	Matches(16, 16, 512, 256, 230, 3);		//cell rows a whole vector wide
+	Matches(7, 11, 333, 130, 255, 4);		//the slowest fade
+	Matches(20, 9, 1000, 95, 64, 5);
+	Matches(5, 5, 63, 40, 180, 6);			//narrower than a tile
+
+	return Failures();
+}
@@ -0,0 +1,110 @@
+#include <vector>
+#include "check.h"
+#include "core/bitmatrix.h"
+#include "core/rng.h"
+
+// the cells of row y found by walking its words with Ctz64, as Message does
+static std::vector<int> Walk(const BitMatrix &m, int y)
+{
+	std::vector<int> out;
+	const uint64_t *row = m.Row(y);
+	for(int w = 0; w < m.Words(); w++)
+		for(uint64_t b = row[w]; b; b &= b - 1)
+			out.push_back(w * 64 + Ctz64(b));
+	return out;
+}
+
+// set, test, reset, count and walk against a plain array of bools
+static void Matches(int width, int height, uint64_t seed)
+{
+	Rng rng(seed);
+	BitMatrix m, other;
+	m.Create(width, height);
+	other.Create(width, height);
+
+	CHECK(m.Width() == width && m.Height() == height);
+	CHECK(m.Words() == (width + 63) / 64);
+	CHECK(m.Count() == 0);
+
+	std::vector<bool> want((size_t)width * height, false), also((size_t)width * height, false);
+
+	for(int i = 0; i < width * height; i++)
+	{
+		int x = (int)rng.Below(width), y = (int)rng.Below(height);
+		if(rng.Below(4) == 0)
+		{
+			m.Reset(x, y);
+			want[(size_t)y * width + x] = false;
+		}
+		else
+		{
+			m.Set(x, y);
+			want[(size_t)y * width + x] = true;
+		}
+
+		x = (int)rng.Below(width);
+		y = (int)rng.Below(height);
+		other.Set(x, y);
+		also[(size_t)y * width + x] = true;
+	}
+
+	//the edges of every word, and the last cell of every row
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x += 63)
+		{
+			m.Set(x, y);
+			want[(size_t)y * width + x] = true;
+		}
+	for(int y = 0; y < height; y += 2)
+	{
+		m.Set(width - 1, y);
+		want[(size_t)y * width + width - 1] = true;
+	}
+
+	int count = 0, both = 0, wrong = 0;
+	for(int y = 0; y < height; y++)
+	{
+		std::vector<int> walk = Walk(m, y), expect;
+		for(int x = 0; x < width; x++)
+		{
+			bool b = want[(size_t)y * width + x];
+			wrong += m.Test(x, y) != b;
+			if(b) expect.push_back(x);
+			count += b;
+			both  += b && also[(size_t)y * width + x];
+		}
+		wrong += walk != expect;
+
+		//and nothing past the width, where the next row's cells would land
+		if(width % 64)
+			wrong += (m.Row(y)[m.Words() - 1] >> (width % 64)) != 0;
+
+		//NextSetBit finds the same cells
+		std::vector<int> next;
+		for(int x = NextSetBit(m.Row(y), width, 0); x < width; x = NextSetBit(m.Row(y), width, x + 1))
+			next.push_back(x);
+		wrong += next != expect;
+	}
+
+	CHECK(wrong == 0);
+	CHECK(m.Count() == count);
+	CHECK(BitMatrix::CountAnd(m, other) == both);
+
+	m.Clear();
+	CHECK(m.Count() == 0 && m.Width() == width && m.Height() == height);
+	CHECK(Walk(m, height - 1).empty());
+}
+
+int main()
+{
+	const int widths[] = { 1, 2, 63, 64, 65, 127, 128, 129, 191, 192, 193, 1000 };
+	for(int i = 0; i < 12; i++)
+	{
+		Matches(widths[i], 1, i);
+		Matches(widths[i], 37, i + 100);
+	}
+
+	BitMatrix empty;
+	CHECK(empty.Width() == 0 && empty.Words() == 0 && empty.Count() == 0);
+	return Failures();
+}
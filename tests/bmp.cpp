@@ -0,0 +1,207 @@
+#include <limits.h>
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "core/bmp.h"
+
+static void Put16(std::vector<uint8_t> &b, size_t at, uint32_t v)
+{
+	b[at] = (uint8_t)v;
+	b[at + 1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(std::vector<uint8_t> &b, size_t at, uint32_t v)
+{
+	for(int i = 0; i < 4; i++) b[at + i] = (uint8_t)(v >> (i * 8));
+}
+
+// a .bmp file of width x height at bpp, with colors palette entries and zeroed rows
+static std::vector<uint8_t> MakeBmp(int width, int height, int bpp, int colors)
+{
+	size_t pitch = ((size_t)(width < 0 ? -width : width) * bpp + 31) / 32 * 4;
+	size_t bits = 14 + 40 + (size_t)colors * 4;
+	std::vector<uint8_t> b(bits + pitch * (size_t)(height < 0 ? -height : height));
+
+	b[0] = 'B'; b[1] = 'M';
+	Put32(b, 2, (uint32_t)b.size());
+	Put32(b, 10, (uint32_t)bits);
+	Put32(b, 14, 40);
+	Put32(b, 18, (uint32_t)width);
+	Put32(b, 22, (uint32_t)height);
+	Put16(b, 26, 1);
+	Put16(b, 28, bpp);
+	Put32(b, 46, colors);
+	return b;
+}
+
+static void Good()
+{
+	BmpView view;
+	BmpImage img;
+
+	std::vector<uint8_t> b = MakeBmp(3, 2, 24, 0);
+	b[14 + 40] = 0x30;	b[14 + 41] = 0x20;	b[14 + 42] = 0x10;	//bottom row, first pixel
+	CHECK(ParseBmp(&b[0], b.size(), view));
+	CHECK(view.width == 3 && view.height == 2 && view.pitch == 12 && !view.topdown);
+	CHECK(DecodeBmp(&b[0], b.size(), img));
+	CHECK(img.pixels[3] == 0x102030);
+
+	b = MakeBmp(5, -4, 8, 2);
+	Put32(b, 14 + 40 + 4, 0x00abcdef);
+	b[14 + 48] = 1;		//top row, first pixel
+	CHECK(ParseBmp(&b[0], b.size(), view));
+	CHECK(view.topdown && view.height == 4 && view.colors == 2);
+	CHECK(DecodeBmp(&b[0], b.size(), img));
+	CHECK(img.pixels[0] == 0xabcdef && img.index[0] == 1 && img.pixels[1] == 0);
+
+	//a packed DIB is the same without the file header
+	CHECK(ParseDib(&b[14], b.size() - 14, view));
+	CHECK(view.width == 5 && view.colors == 2);
+}
+
+// 1 and 4 bpp, bits packed from the top of each byte
+static void Packed()
+{
+	BmpImage img;
+
+	std::vector<uint8_t> b = MakeBmp(10, -1, 1, 2);
+	Put32(b, 14 + 44, 0xffffff);
+	b[14 + 48] = 0xa5;		//1010 0101
+	b[14 + 49] = 0x40;		//01
+	CHECK(DecodeBmp(&b[0], b.size(), img));
+	CHECK(img.colors == 2);
+	const uint8_t bits[10] = { 1, 0, 1, 0, 0, 1, 0, 1, 0, 1 };
+	for(int x = 0; x < 10; x++)
+		CHECK(img.index[x] == bits[x] && img.pixels[x] == (bits[x] ? 0xffffffu : 0));
+
+	b = MakeBmp(3, 1, 4, 16);
+	Put32(b, 14 + 40 + 15 * 4, 0x123456);
+	Put32(b, 14 + 40 + 2 * 4, 0x654321);
+	b[14 + 40 + 64] = 0xf2;
+	b[14 + 40 + 65] = 0xf0;
+	CHECK(DecodeBmp(&b[0], b.size(), img));
+	CHECK(img.index[0] == 15 && img.index[1] == 2 && img.index[2] == 15);
+	CHECK(img.pixels[0] == 0x123456 && img.pixels[1] == 0x654321);
+
+	//a palette shorter than the depth allows
+	b = MakeBmp(2, 1, 4, 3);
+	CHECK(DecodeBmp(&b[0], b.size(), img));
+	CHECK(img.colors == 3);
+}
+
+// a BI_BITFIELDS file: 40-byte header, then the three masks, then rows
+static std::vector<uint8_t> MakeFields(int width, int bpp, uint32_t r, uint32_t g, uint32_t b)
+{
+	std::vector<uint8_t> f = MakeBmp(width, 1, bpp, 0);
+	f.insert(f.begin() + 14 + 40, 12, 0);
+	Put32(f, 10, 14 + 40 + 12);
+	Put32(f, 30, 3);
+	Put32(f, 14 + 40, r);
+	Put32(f, 14 + 44, g);
+	Put32(f, 14 + 48, b);
+	return f;
+}
+
+static void Fields()
+{
+	BmpImage img;
+	BmpView view;
+
+	//32 bpp in the other byte order, with alpha
+	std::vector<uint8_t> f = MakeFields(2, 32, 0xff, 0xff00, 0xff0000);
+	Put32(f, 66, 0x80332211);
+	CHECK(DecodeBmp(&f[0], f.size(), img));
+	CHECK(img.pixels[0] == 0x112233 && img.pixels[1] == 0);
+
+	//the same masks in a V4 header
+	std::vector<uint8_t> v4 = MakeBmp(1, 1, 32, 0);
+	v4.insert(v4.begin() + 14 + 40, 108 - 40, 0);
+	Put32(v4, 10, 14 + 108);
+	Put32(v4, 14, 108);
+	Put32(v4, 30, 3);
+	Put32(v4, 14 + 40, 0xff);
+	Put32(v4, 14 + 44, 0xff00);
+	Put32(v4, 14 + 48, 0xff0000);
+	Put32(v4, 14 + 108, 0x00ccbbaa);
+	CHECK(DecodeBmp(&v4[0], v4.size(), img));
+	CHECK(img.pixels[0] == 0xaabbcc);
+
+	//16 bpp 5-6-5, and 10-bit channels scaled down
+	f = MakeFields(2, 16, 0xf800, 0x07e0, 0x001f);
+	Put16(f, 66, 0xffff);
+	Put16(f, 68, 0x0820);	//red 1, green 1
+	CHECK(DecodeBmp(&f[0], f.size(), img));
+	CHECK(img.pixels[0] == 0xffffff && img.pixels[1] == 0x080400);
+
+	f = MakeFields(1, 32, 0x3ff00000, 0x000ffc00, 0x000003ff);
+	Put32(f, 66, 0x3ff80000);	//red all, green 0x200 of 0x3ff, blue none
+	CHECK(DecodeBmp(&f[0], f.size(), img));
+	CHECK(img.pixels[0] == 0xff8000);
+
+	//plain 16 bpp is 5-5-5
+	f = MakeBmp(1, 1, 16, 0);
+	Put16(f, 54, 0x7c00);
+	CHECK(DecodeBmp(&f[0], f.size(), img));
+	CHECK(img.pixels[0] == 0xff0000);
+
+	//masks that aren't a run of bits, or are missing, or on the wrong depth
+	f = MakeFields(1, 32, 0xff, 0xf0f000, 0xff0000);
+	CHECK(!ParseBmp(&f[0], f.size(), view));
+	f = MakeFields(1, 32, 0, 0xff00, 0xff0000);
+	CHECK(!ParseBmp(&f[0], f.size(), view));
+	f = MakeFields(1, 24, 0xff, 0xff00, 0xff0000);
+	CHECK(!ParseBmp(&f[0], f.size(), view));
+	f = MakeFields(1, 32, 0xff, 0xff00, 0xff0000);
+	CHECK(!ParseDib(&f[14], 40 + 8, view));
+}
+
+static void Bad()
+{
+	BmpView view;
+	std::vector<uint8_t> b = MakeBmp(4, 4, 32, 0);
+
+	//every truncation
+	for(size_t n = 0; n < b.size(); n++)
+		CHECK(!ParseBmp(&b[0], n, view));
+
+	//heights that can't be negated, or are out of reach
+	std::vector<uint8_t> c = b;
+	Put32(c, 22, (uint32_t)INT_MIN);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+	Put32(c, 22, 0);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+	Put32(c, 22, 0x40000000);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+
+	//widths whose rows wrap 32 bits, with a height to match
+	c = b;
+	Put32(c, 18, 0x40000001);
+	Put32(c, 22, 1);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+	Put32(c, 18, 65537);
+	Put32(c, 22, 65536);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+	Put32(c, 18, 0);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+
+	//a palette, or bits, beyond the end
+	c = MakeBmp(4, 4, 24, 0);
+	Put32(c, 46, 0xffffffff);
+	CHECK(!ParseDib(&c[14], c.size() - 14, view));
+	Put32(c, 10, 0xfffffff0);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+
+	//compressed
+	c = b;
+	Put32(c, 30, 1);
+	CHECK(!ParseBmp(&c[0], c.size(), view));
+}
+
+int main()
+{
+	Good();
+	Packed();
+	Fields();
+	Bad();
+	return Failures();
+}
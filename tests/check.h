@@ -0,0 +1,21 @@
+#ifndef MATRIX_CHECK_INC
+#define MATRIX_CHECK_INC
+
+#include <stdio.h>
+
+//
+//	Just enough of a test harness: CHECK reports a failed condition and
+//	carries on, and main returns Failures() so ctest sees the result.
+//
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if(!(cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+static inline int Failures()
+{
+	if(failures) fprintf(stderr, "%d check(s) failed\n", failures);
+	return failures ? 1 : 0;
+}
+
+#endif
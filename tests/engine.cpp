@@ -0,0 +1,285 @@
+#include <vector>
+#include "check.h"
+#include "core/engine.h"
+#include "core/rng.h"
+#include "core/simd.h"
+
+//
+//	One column the way the original Matrix::ScrollDown ran it: initcount
+//	and statecount counted down every tick, the blip moved by hand. It
+//	draws from the column's stream in the engine's order, so the engine's
+//	timing wheel, scroll kernel and bitsets have to land on exactly the
+//	same grid.
+//
+struct RefColumn
+{
+	Rng  rng;
+	int  state, statecount, initcount, blippos, bliplen;
+	bool started, flip;
+	std::vector<int>  in, glyph;
+	std::vector<bool> update;
+
+	// MatrixEngine::InitColumn, from Create (numrows is still 0 then)
+	void Init(uint64_t seed, int x, int maxcols, int maxrows)
+	{
+		rng.Seed(seed, (uint32_t)x);
+		state      = rng.Below(2);
+		statecount = rng.Below(20) + 3;
+		initcount  = rng.Below(maxcols);
+		started    = false;
+		flip       = false;
+		blippos    = 0;
+		bliplen    = rng.Below(50);
+
+		in.assign(maxrows + 11, -1);
+		glyph.assign(maxrows + 11, 0);
+		update.assign(maxrows + 11, false);
+	}
+
+	void Toggle(int density)
+	{
+		state ^= 1;
+		if(state == 0) statecount = rng.Below(DENSITY_MAX + 1 - density) + (DENSITY_MIN * 2);
+		else           statecount = rng.Below(3 * density / 2) + DENSITY_MIN;
+	}
+
+	void Mark(int runlen)
+	{
+		int b = blippos;
+		if(b >= 0 && b < runlen)
+			update[b] = update[b + 1] = update[b + 8] = update[b + 9] = true;
+	}
+
+	void Tick(int numrows, int runlen, int numglyphs, int density)
+	{
+		update.assign(update.size(), false);
+
+		if(!started)
+		{
+			if(--initcount <= 0) started = true;
+			return;
+		}
+
+		//a statecount that ran out last tick takes effect now
+		if(flip)
+		{
+			Toggle(density);
+			flip = false;
+		}
+
+		//jjrandomise: new glyphs for some of the bright digits
+		int p = 0;
+		for(int i = 1; i < 20; i++)
+		{
+			while(p < numrows && in[p] != MATRIX_BRIGHT) p++;
+			if(p >= numrows) break;
+			glyph[p] = rng.Below(numglyphs);
+			p += rng.Below(10);
+		}
+
+		int old = state ? MATRIX_BRIGHT : -1;
+
+		for(int i = 0; i < numrows; i++)
+		{
+			int run = in[i];
+
+			if(run > old && run >= 0)
+			{
+				in[i]--;
+				update[i] = true;
+				if(run == MATRIX_BRIGHT) i++;
+			}
+			else if(old >= 0 && run < 0)
+			{
+				in[i]     = MATRIX_BRIGHT;
+				glyph[i]  = rng.Below(numglyphs);
+				update[i] = true;
+				i++;
+			}
+
+			if(i < numrows) old = in[i];
+		}
+
+		if(--statecount <= 0) flip = true;
+
+		Mark(runlen);
+		blippos += 2;
+		if(blippos >= bliplen)
+		{
+			bliplen = numrows + rng.Below(50);
+			blippos = 0;
+		}
+		Mark(runlen);
+	}
+
+	int Intensity(int y) const
+	{
+		if(in[y] < 0) return -1;
+		int b = blippos;
+		return b == y || b + 1 == y || b + 8 == y || b + 9 == y ? MATRIX_BLIP : in[y];
+	}
+};
+
+// count the cells where the engine and the reference columns disagree
+static int Differences(const MatrixEngine &e, const std::vector<RefColumn> &ref)
+{
+	int bad = 0;
+
+	for(int x = 0; x < e.NumCols(); x++)
+		for(int y = 0; y < e.NumRows(); y++)
+		{
+			const RefColumn &c = ref[x];
+			if(e.IntensityRow(y)[x] != c.in[y]) bad++;
+			if(e.Intensity(x, y) != c.Intensity(y)) bad++;
+			if(e.GlyphRow(y)[x] != c.glyph[y]) bad++;
+			if(e.IsDirty(x, y) != c.update[y]) bad++;
+		}
+
+	return bad;
+}
+
+static void MatchesCountdown(int kernel, int threads)
+{
+	const uint64_t seed = 1234;
+	const int maxcols = 150, maxrows = 70, density = 20;
+
+	MatrixEngine e;
+	e.SetKernel(kernel);
+	e.SetThreads(threads);
+	e.Create(maxcols, maxrows, density, seed);
+	e.Resize(149, 60);
+
+	std::vector<RefColumn> ref(maxcols);
+	for(int x = 0; x < maxcols; x++)
+		ref[x].Init(seed, x, maxcols, maxrows);
+
+	int bad = 0, lit = 0;
+	for(int t = 0; t < 600 && bad == 0; t++)
+	{
+		e.Step();
+		for(int x = 0; x < e.NumCols(); x++)
+			ref[x].Tick(e.NumRows(), maxrows + 1, e.NumGlyphs(), density);
+
+		bad = Differences(e, ref);
+		if(bad) fprintf(stderr, "kernel %d, %d threads: %d differences on tick %d\n", kernel, threads, bad, t + 1);
+
+		for(int x = 0; x < e.NumCols(); x++)
+			lit += e.NextDirtyRow(x, 0) < e.NumRows();
+
+		e.ClearDirty();
+	}
+
+	CHECK(bad == 0);
+	CHECK(lit > 0);
+}
+
+// the whole visible grid, for comparing engines with each other
+static std::vector<int> Grid(const MatrixEngine &e)
+{
+	std::vector<int> g;
+	for(int y = 0; y < e.NumRows(); y++)
+		for(int x = 0; x < e.NumCols(); x++)
+			g.push_back(e.Intensity(x, y) << 16 | e.Glyph(x, y) | (e.IsDirty(x, y) ? 1 << 15 : 0));
+	return g;
+}
+
+// columns outside a shrunk area go blank and stay quiet; the same on any thread count
+static void Resize()
+{
+	MatrixEngine a, b;
+	b.SetThreads(4);
+
+	a.Create(300, 50, 30, 99);
+	b.Create(300, 50, 30, 99);
+
+	const int sizes[][2] = { { 299, 49 }, { 100, 20 }, { 0, 0 }, { 170, 49 }, { 64, 30 }, { 65, 31 } };
+
+	for(int s = 0; s < 6; s++)
+	{
+		a.Resize(sizes[s][0], sizes[s][1]);
+		b.Resize(sizes[s][0], sizes[s][1]);
+
+		//0 means as big as the grid allows
+		CHECK(a.NumCols() == (sizes[s][0] ? sizes[s][0] : 299));
+		CHECK(a.NumRows() == (sizes[s][1] ? sizes[s][1] : 49));
+
+		for(int t = 0; t < 200; t++)
+		{
+			a.Step();
+			b.Step();
+
+			int stray = 0;
+			for(int y = 0; y < a.NumRows(); y++)
+				for(int x = a.NumCols(); x < a.MaxCols(); x++)
+					stray += a.IsDirty(x, y);
+			CHECK(stray == 0);
+
+			if(t % 50 == 49)
+				CHECK(Grid(a) == Grid(b));
+
+			a.ClearDirty();
+			b.ClearDirty();
+		}
+
+		//columns past the edge are blank
+		int outside = 0;
+		for(int y = 0; y < a.NumRows(); y++)
+			for(int x = a.NumCols(); x < a.MaxCols(); x++)
+				outside += a.IntensityRow(y)[x] >= 0;
+		CHECK(outside == 0);
+	}
+
+	//after growing back, every column has started again
+	a.Resize(299, 49);
+	int quiet = 0;
+	std::vector<bool> seen(299, false);
+	for(int t = 0; t < 400; t++)
+	{
+		a.Step();
+		for(int x = a.NextDirtyColumn(0); x < a.NumCols(); x = a.NextDirtyColumn(x + 1))
+			seen[x] = true;
+		a.ClearDirty();
+	}
+	for(int x = 0; x < 299; x++)
+		quiet += !seen[x];
+	CHECK(quiet == 0);
+}
+
+// fewer glyphs folds the grid into range, and only those are picked after
+static void Glyphs()
+{
+	MatrixEngine e;
+	e.Create(80, 40, 25, 7);
+	e.Resize(79, 39);
+
+	for(int t = 0; t < 200; t++) e.Step();
+
+	e.SetGlyphs(5);
+	CHECK(e.NumGlyphs() == 5);
+
+	for(int t = 0; t < 200; t++)
+	{
+		int high = 0;
+		for(int y = 0; y < e.NumRows(); y++)
+			for(int x = 0; x < e.NumCols(); x++)
+				high += e.Glyph(x, y) >= 5;
+		CHECK(high == 0);
+		e.Step();
+	}
+
+	e.SetGlyphs(0);
+	CHECK(e.NumGlyphs() == 1);
+	e.SetGlyphs(MATRIX_MAXGLYPHS + 1);
+	CHECK(e.NumGlyphs() == MATRIX_MAXGLYPHS);
+}
+
+int main()
+{
+	MatchesCountdown(SIMD_SCALAR, 1);
+	MatchesCountdown(SIMD_SSE2, 1);
+	MatchesCountdown(SIMD_AVX2, 1);
+	MatchesCountdown(SIMD_AUTO, 3);
+	Resize();
+	Glyphs();
+	return Failures();
+}
@@ -0,0 +1,179 @@
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "check.h"
+#include "core/feed.h"
+
+#define FEED_FILE	"test-feed.log"
+
+static void Nap(int ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// wait up to ms for done() to come true
+template<class F> static bool WaitFor(F done, int ms)
+{
+	for(; ms > 0; ms -= 10)
+	{
+		if(done()) return true;
+		Nap(10);
+	}
+	return done();
+}
+
+static void Write(const char *mode, const std::string &text)
+{
+	FILE *fp = fopen(FEED_FILE, mode);
+	if(fp == 0) return;
+	fwrite(text.data(), 1, text.size(), fp);
+	fclose(fp);
+}
+
+static std::atomic<int> opens(0);
+
+static FILE *OpenFeed(void *)
+{
+	opens++;
+	return fopen(FEED_FILE, "rb");
+}
+
+// start on FEED_FILE, once the reader is sitting at its end
+static void StartFeed(MessageFeed &feed)
+{
+	opens = 0;
+	feed.Start(OpenFeed, 0);
+	CHECK(WaitFor([]() { return opens > 0; }, 2000));
+	Nap(FEED_POLL_MS * 2);
+}
+
+static std::string Pop(MessageFeed &feed)
+{
+	FeedLine line;
+	if(!WaitFor([&]() { return feed.TryPop(line); }, 2000))
+		return "(nothing)";
+	return line.text;
+}
+
+// only what is appended after the start, a line at a time, cleaned up
+static void Tail()
+{
+	Write("wb", "old line\n");
+
+	MessageFeed feed;
+	StartFeed(feed);
+
+	Write("ab", "first\n");
+	CHECK(Pop(feed) == "first");
+	Write("ab", "  second  \n\nthi");
+	CHECK(Pop(feed) == "second");
+
+	//a partial line waits for the rest
+	Nap(FEED_POLL_MS * 2);
+	CHECK(feed.Pending() == 0);
+	Write("ab", "rd\x01\n");
+	CHECK(Pop(feed) == "third");
+
+	CHECK(feed.Lines() == 3);
+	CHECK(feed.Dropped() == 0);
+	feed.Stop();
+}
+
+// a file that shrinks is read again from the start
+static void Truncate()
+{
+	Write("wb", "");
+
+	MessageFeed feed;
+	StartFeed(feed);
+
+	Write("ab", "a long line before the file is truncated\n");
+	CHECK(Pop(feed) == "a long line before the file is truncated");
+
+	Write("wb", "after\n");
+	CHECK(Pop(feed) == "after");
+
+	CHECK(feed.Lines() == 2);
+	feed.Stop();
+}
+
+// a long line is cut to FEED_LINELEN - 1 bytes, less any character the cut splits
+static void Cut()
+{
+	Write("wb", "");
+
+	MessageFeed feed;
+	StartFeed(feed);
+
+	static const char *chars[] = { "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80" };	//2, 3 and 4 bytes
+	const size_t keep = FEED_LINELEN - 1;
+	int lines = 0;
+
+	for(int c = 0; c < 3; c++)
+	{
+		size_t len = strlen(chars[c]);
+
+		//the character ends past, exactly at and before the cut
+		for(size_t p = keep - len - 1; p < keep; p++)
+		{
+			std::string text = std::string(p, 'a') + chars[c] + std::string(20, 'b');
+			std::string want = p + len <= keep ? text.substr(0, keep) : std::string(p, 'a');
+
+			Write("ab", text + "\n");
+			CHECK(Pop(feed) == want);
+			lines++;
+		}
+	}
+
+	CHECK(feed.Lines() == (uint32_t)lines);
+	CHECK(feed.Dropped() == 0);
+	feed.Stop();
+}
+
+// with nobody reading, the queue fills and then only the newest line is kept
+static void Stall()
+{
+	Write("wb", "");
+
+	MessageFeed feed;
+	StartFeed(feed);
+
+	const int burst = FEED_QUEUE + 10;
+	std::string text;
+	for(int i = 0; i < burst; i++)
+		text += "line " + std::to_string(i) + "\n";
+	Write("ab", text);
+
+	//one wait for the queue, not one per line
+	CHECK(WaitFor([&]() { return feed.Lines() == burst; }, FEED_WAIT_MS * 4));
+	CHECK(feed.Pending() == FEED_QUEUE + 1);
+	CHECK(feed.Dropped() == burst - FEED_QUEUE - 1);
+
+	//the display gets the last line, not the oldest queued
+	CHECK(Pop(feed) == "line " + std::to_string(burst - 1));
+	CHECK(feed.Pending() == 0);
+	CHECK(feed.Dropped() == burst - 1);
+
+	//once taken, lines flow through the queue again
+	Write("ab", "more\n");
+	CHECK(Pop(feed) == "more");
+
+	//and a burst that fits is passed over for its last line too
+	Write("ab", "a\nb\nc\n");
+	CHECK(WaitFor([&]() { return feed.Pending() == 3; }, 2000));
+	CHECK(Pop(feed) == "c");
+	CHECK(feed.Dropped() == burst + 1);
+	CHECK(feed.Lines() == burst + 4);
+	feed.Stop();
+}
+
+int main()
+{
+	Tail();
+	Truncate();
+	Cut();
+	Stall();
+	remove(FEED_FILE);
+	return Failures();
+}
@@ -0,0 +1,243 @@
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "core/aligned.h"
+#include "core/bits.h"
+#include "core/engine.h"
+#include "core/kernel.h"
+#include "core/rng.h"
+#include "core/simd.h"
+
+#define LANES 64				//one strip, as MatrixEngine calls it
+
+inline int INTENSITY(int n) { return (n < 0 ? -1 : n/32); }
+
+//
+//	The original Matrix::ScrollDown scroll, on one column of run[] chars
+//	(-1 blank, else intensity * 32 + glyph), with jjrand left out: an
+//	inserted digit is 96. update[] is what it marked, bright[] the digits
+//	jjrandomise would have picked from before it.
+//
+static void ScrollDown(int *run, int numrows, int state, bool *update, bool *bright, bool *inserted)
+{
+	for (int i = 0; i < numrows; i++) {
+		update[i] = false;
+		inserted[i] = false;
+		bright[i] = run[i] >= 96;
+	}
+
+	int oldchar = state ? 127 : -1;
+
+	for (int i = 0; i < numrows; i++) {
+		int oldins = INTENSITY(oldchar);
+		int runins = INTENSITY(run[i]);
+
+		if (runins > oldins && runins >= 0) {
+			run[i] -= 32;
+			update[i] = true;
+			if (runins == 3) i++;
+		} else if (oldins >= 0 && runins < 0) {
+			run[i] = 96;
+			update[i] = true;
+			inserted[i] = true;
+			i++;
+		}
+		oldchar = run[i];
+	}
+}
+
+// a strip's buffers, laid out as MatrixEngine has them
+struct Strip
+{
+	int numcols, numrows, stride, words;
+	signed char   *intensity;
+	unsigned char *active, *skip;
+	signed char   *old;
+	std::vector<uint64_t> bright, insert, dirty;
+	uint64_t touched;
+
+	Strip(int cols, int rows) : numcols(cols), numrows(rows), stride(LANES), words(BitWords(rows + 10)), touched(0)
+	{
+		//a spare row, as the engine's runlen has
+		intensity = (signed char *)AlignedAlloc((size_t)(rows + 1) * stride);
+		active    = (unsigned char *)AlignedAlloc(LANES);
+		skip      = (unsigned char *)AlignedAlloc(LANES);
+		old       = (signed char *)AlignedAlloc(LANES);
+		memset(intensity, -1, (size_t)(rows + 1) * stride);
+		memset(active, 0, LANES);
+	}
+
+	~Strip()
+	{
+		AlignedFree(intensity);
+		AlignedFree(active);
+		AlignedFree(skip);
+		AlignedFree(old);
+	}
+
+	void Run(const int *state, int level)
+	{
+		for(int x = 0; x < LANES; x++)
+		{
+			old[x]  = (signed char)(x < numcols && state[x] ? MATRIX_BRIGHT : -1);
+			skip[x] = 0;
+		}
+
+		bright.assign((size_t)LANES * words, 0);
+		insert.assign((size_t)LANES * words, 0);
+
+		ScrollArgs a;
+		a.intensity = intensity;
+		a.stride    = stride;
+		a.numcols   = numcols;
+		a.numrows   = numrows;
+		a.active    = active;
+		a.old       = old;
+		a.skip      = skip;
+		a.bright    = &bright[0];
+		a.insert    = &insert[0];
+		a.dirty     = &dirty[0];
+		a.touched   = &touched;
+		a.words     = words;
+
+		ScrollKernel(a, level);
+	}
+};
+
+//
+//	Random strips, ticked over and over, through every kernel level and
+//	the original scroll side by side. Widths take in tails that aren't a
+//	whole SSE2 or AVX2 vector, and lanes are switched on and off at
+//	random, so skipped rows and idle lanes get mixed in with running ones.
+//
+static void Matches(int numcols, int numrows, uint64_t seed)
+{
+	Rng rng(seed);
+	const int levels[] = { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+	std::vector<Strip *> strips;
+	for(int l = 0; l < 3; l++)
+	{
+		strips.push_back(new Strip(numcols, numrows));
+		strips[l]->dirty.assign((size_t)LANES * strips[l]->words, 0);
+	}
+
+	//the original's columns: run chars, with glyph 0
+	std::vector<std::vector<int> > run(numcols, std::vector<int>(numrows + 1, -1));
+	for(int x = 0; x < numcols; x++)
+		for(int y = 0; y < numrows; y++)
+		{
+			int in = (int)rng.Below(6) - 1;
+			if(in > MATRIX_BRIGHT) in = -1;
+			run[x][y] = in < 0 ? -1 : in * 32;
+			for(int l = 0; l < 3; l++)
+				strips[l]->intensity[y * LANES + x] = (signed char)in;
+		}
+
+	//lanes past numcols hold whatever they like and must come through untouched
+	std::vector<signed char> tail((size_t)numrows * LANES);
+	for(int y = 0; y < numrows; y++)
+		for(int x = numcols; x < LANES; x++)
+		{
+			tail[(size_t)y * LANES + x] = (signed char)((int)rng.Below(5) - 1);
+			for(int l = 0; l < 3; l++)
+				strips[l]->intensity[y * LANES + x] = tail[(size_t)y * LANES + x];
+		}
+
+	std::vector<bool> dirty((size_t)numcols * numrows, false);
+	uint64_t touched = 0;
+	int bad = 0, changed = 0;
+
+	for(int t = 0; t < 40 && bad == 0; t++)
+	{
+		int state[LANES] = { 0 };
+		bool on[LANES] = { false };
+
+		for(int x = 0; x < numcols; x++)
+		{
+			state[x] = (int)rng.Below(2);
+			on[x] = rng.Below(4) != 0;
+			for(int l = 0; l < 3; l++)
+				strips[l]->active[x] = on[x] ? 0xff : 0;
+		}
+
+		for(int l = 0; l < 3; l++)
+			strips[l]->Run(state, levels[l]);
+
+		for(int x = 0; x < numcols; x++)
+		{
+			bool update[512], bright[512], inserted[512];
+
+			//an idle lane is left alone, but still reports its bright cells
+			if(on[x])
+				ScrollDown(&run[x][0], numrows, state[x], update, bright, inserted);
+			else
+				for(int y = 0; y < numrows; y++)
+				{
+					update[y] = inserted[y] = false;
+					bright[y] = run[x][y] >= 96;
+				}
+
+			for(int y = 0; y < numrows; y++)
+				if(update[y])
+				{
+					dirty[(size_t)x * numrows + y] = true;
+					touched |= (uint64_t)1 << x;
+					changed++;
+				}
+
+			for(int l = 0; l < 3; l++)
+			{
+				const Strip &s = *strips[l];
+				for(int y = 0; y < numrows; y++)
+				{
+					const uint64_t *col = &s.bright[(size_t)x * s.words];
+					bad += TestBit(col, y) != bright[y];
+					bad += TestBit(&s.insert[(size_t)x * s.words], y) != inserted[y];
+					bad += TestBit(&s.dirty[(size_t)x * s.words], y) != dirty[(size_t)x * numrows + y];
+				}
+			}
+		}
+
+		for(int l = 0; l < 3; l++)
+		{
+			const Strip &s = *strips[l];
+
+			for(int x = 0; x < numcols; x++)
+				for(int y = 0; y < numrows; y++)
+					bad += s.intensity[y * LANES + x] != INTENSITY(run[x][y]);
+
+			//nothing outside the strip's columns
+			for(int x = numcols; x < LANES; x++)
+			{
+				for(int w = 0; w < s.words; w++)
+					bad += (s.bright[(size_t)x * s.words + w] | s.insert[(size_t)x * s.words + w] | s.dirty[(size_t)x * s.words + w]) != 0;
+				for(int y = 0; y < numrows; y++)
+					bad += s.intensity[y * LANES + x] != tail[(size_t)y * LANES + x];
+			}
+
+			bad += s.touched != touched;
+		}
+
+		if(bad)
+			fprintf(stderr, "%d columns x %d rows: %d differences on tick %d\n", numcols, numrows, bad, t);
+	}
+
+	CHECK(bad == 0);
+	CHECK(changed > 0);
+
+	for(int l = 0; l < 3; l++)
+		delete strips[l];
+}
+
+int main()
+{
+	printf("kernels: scalar, %s, %s\n", SimdName(SimdResolve(SIMD_SSE2)), SimdName(SimdResolve(SIMD_AVX2)));
+
+	const int widths[] = { 1, 5, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64 };
+	for(int w = 0; w < 12; w++)
+		for(int rows = 1; rows < 140; rows += 23)
+			Matches(widths[w], rows, (uint64_t)w * 1000 + rows);
+
+	return Failures();
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "core/maskcache.h"
+#include "core/rng.h"
+
+// a mask with some lit rows in the middle and blank ones after
+static BitMatrix Random(int width, int height, int litrows, Rng &rng)
+{
+	BitMatrix m(width, height);
+	for(int y = 0; y < litrows && y < height; y++)
+		for(int x = 0; x < width; x++)
+			if(rng.Below(3) == 0) m.Set(x, y);
+	return m;
+}
+
+static bool Same(const BitMatrix &a, const BitMatrix &b)
+{
+	if(a.Width() != b.Width() || a.Height() != b.Height()) return false;
+	for(int y = 0; y < a.Height(); y++)
+		for(int x = 0; x < a.Width(); x++)
+			if(a.Test(x, y) != b.Test(x, y)) return false;
+	return true;
+}
+
+static std::string Key(int i)
+{
+	char buf[16];
+	snprintf(buf, sizeof(buf), "msg%d", i);
+	return buf;
+}
+
+static void PutGet()
+{
+	Rng rng(1);
+	MaskCache cache;
+	BitMatrix out;
+
+	CHECK(!cache.Changed());
+	CHECK(!cache.Get("none", out));
+
+	BitMatrix a = Random(70, 20, 12, rng), b = Random(5, 3, 3, rng), blank(9, 9);
+	cache.Put("a", a);
+	cache.Put("b", b);
+	cache.Put("blank", blank);
+	CHECK(cache.Size() == 3);
+	CHECK(cache.Changed());
+
+	//resized to the cached mask
+	CHECK(cache.Get("a", out) && Same(out, a));
+	CHECK(cache.Get("b", out) && Same(out, b));
+	CHECK(cache.Get("blank", out) && Same(out, blank));
+
+	//same size: stale bits below the stored rows are cleared
+	out.Create(70, 20);
+	for(int y = 0; y < 20; y++) out.Set(69, y);
+	CHECK(cache.Get("a", out) && Same(out, a));
+
+	//putting a key again replaces it
+	BitMatrix c = Random(33, 8, 2, rng);
+	cache.Put("a", c);
+	CHECK(cache.Size() == 3);
+	CHECK(cache.Get("a", out) && Same(out, c));
+
+	cache.Clear();
+	CHECK(cache.Size() == 0 && !cache.Get("b", out));
+}
+
+static void Eviction()
+{
+	Rng rng(2);
+	MaskCache cache;
+	std::vector<BitMatrix> masks;
+	BitMatrix out;
+
+	for(int i = 0; i < MASKCACHE_ENTRIES; i++)
+	{
+		masks.push_back(Random(10 + i, 4, 2, rng));
+		cache.Put(Key(i), masks[i]);
+	}
+	CHECK(cache.Size() == MASKCACHE_ENTRIES);
+
+	//touch the oldest two; msg2 is now the least recently used
+	CHECK(cache.Get(Key(0), out));
+	CHECK(cache.Get(Key(1), out));
+
+	cache.Put("new", masks[5]);
+	CHECK(cache.Size() == MASKCACHE_ENTRIES);
+	CHECK(!cache.Get(Key(2), out));
+	CHECK(cache.Get(Key(0), out) && Same(out, masks[0]));
+	CHECK(cache.Get(Key(1), out) && Same(out, masks[1]));
+	CHECK(cache.Get("new", out) && Same(out, masks[5]));
+
+	//and then msg3
+	cache.Put("newer", masks[6]);
+	CHECK(!cache.Get(Key(3), out));
+	CHECK(cache.Get(Key(4), out));
+}
+
+static std::vector<uint8_t> Bytes(FILE *fp)
+{
+	std::vector<uint8_t> out;
+	rewind(fp);
+	for(int c; (c = fgetc(fp)) != EOF; ) out.push_back((uint8_t)c);
+	return out;
+}
+
+static FILE *FileOf(const std::vector<uint8_t> &bytes)
+{
+	FILE *fp = tmpfile();
+	if(!bytes.empty()) fwrite(&bytes[0], 1, bytes.size(), fp);
+	rewind(fp);
+	return fp;
+}
+
+static void RoundTrip()
+{
+	Rng rng(3);
+	MaskCache cache;
+	std::vector<BitMatrix> masks;
+	BitMatrix out;
+
+	for(int i = 0; i < MASKCACHE_ENTRIES; i++)
+	{
+		masks.push_back(Random(1 + (int)rng.Below(200), 1 + (int)rng.Below(30), (int)rng.Below(30), rng));
+		cache.Put(Key(i), masks[i]);
+	}
+	CHECK(cache.Get(Key(0), out));		//msg1 becomes the oldest
+
+	FILE *fp = tmpfile();
+	CHECK(cache.Write(fp));
+	CHECK(!cache.Changed());
+	rewind(fp);
+
+	MaskCache back;
+	back.Put("stale", masks[0]);
+	CHECK(back.Read(fp));
+	fclose(fp);
+
+	CHECK(!back.Changed());
+	CHECK(back.Size() == MASKCACHE_ENTRIES);
+	CHECK(!back.Get("stale", out));
+
+	//recency came back with it
+	back.Put("new", masks[0]);
+	CHECK(!back.Get(Key(1), out));
+
+	for(int i = 0; i < MASKCACHE_ENTRIES; i++)
+		if(i != 1) CHECK(back.Get(Key(i), out) && Same(out, masks[i]));
+
+	//an empty cache round trips too
+	MaskCache none, none2;
+	fp = tmpfile();
+	CHECK(none.Write(fp));
+	rewind(fp);
+	CHECK(none2.Read(fp) && none2.Size() == 0);
+	fclose(fp);
+}
+
+static void Put32(std::vector<uint8_t> &b, size_t at, uint32_t v)
+{
+	b[at] = (uint8_t)v; b[at + 1] = (uint8_t)(v >> 8); b[at + 2] = (uint8_t)(v >> 16); b[at + 3] = (uint8_t)(v >> 24);
+}
+
+static bool Reads(const std::vector<uint8_t> &bytes)
+{
+	MaskCache cache;
+	Rng rng(4);
+	cache.Put("old", Random(8, 8, 8, rng));
+
+	FILE *fp = FileOf(bytes);
+	bool ok = cache.Read(fp);
+	fclose(fp);
+
+	//a rejected file leaves nothing behind
+	if(!ok) CHECK(cache.Size() == 0);
+	return ok;
+}
+
+static void Corrupt()
+{
+	Rng rng(5);
+	MaskCache cache;
+	cache.Put("key", Random(100, 10, 6, rng));
+	cache.Put("other", Random(3, 2, 1, rng));
+
+	FILE *fp = tmpfile();
+	CHECK(cache.Write(fp));
+	std::vector<uint8_t> good = Bytes(fp);
+	fclose(fp);
+
+	CHECK(Reads(good));
+
+	//every truncation
+	for(size_t n = 0; n < good.size(); n++)
+		CHECK(!Reads(std::vector<uint8_t>(good.begin(), good.begin() + n)));
+
+	//the first entry's header starts after magic, version and count
+	const size_t entry = 12;
+	std::vector<uint8_t> b;
+
+	b = good; Put32(b, 0, 0x12345678);				CHECK(!Reads(b));	//magic
+	b = good; Put32(b, 4, MASKCACHE_VERSION + 1);			CHECK(!Reads(b));	//version
+	b = good; Put32(b, 8, MASKCACHE_ENTRIES + 1);			CHECK(!Reads(b));	//count
+	b = good; Put32(b, 8, 3);					CHECK(!Reads(b));	//more entries than there are
+	b = good; Put32(b, entry + 12, 11);				CHECK(!Reads(b));	//rows past height
+	b = good; Put32(b, entry + 4, 0x10000);				CHECK(!Reads(b));	//wider than any grid
+
+	//sizes the file can't hold are turned down before anything is allocated
+	b = good; Put32(b, entry, 0xffffffff);				CHECK(!Reads(b));	//key length
+	b = good; Put32(b, entry + 4, 0xffff); Put32(b, entry + 8, 0xffff); Put32(b, entry + 12, 0xffff);
+	CHECK(!Reads(b));
+}
+
+int main()
+{
+	PutGet();
+	Eviction();
+	RoundTrip();
+	Corrupt();
+
+	return Failures();
+}
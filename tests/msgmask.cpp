@@ -0,0 +1,149 @@
+#include <vector>
+#include "check.h"
+#include "core/msgmask.h"
+#include "core/rng.h"
+
+// a channel value around the threshold, or one well to either side of it
+static uint32_t Channel(Rng &rng)
+{
+	static const uint32_t near[] = { 0x00, 0x5f, 0x60, 0x61, 0xff };
+	return rng.Below(2) ? near[rng.Below(5)] : rng.Below(256);
+}
+
+// SetMessage's original GetPixel loop, cut off at the bottom of the mask
+static void Reference(const std::vector<uint32_t> &pixels, int pitch, int width, int height,
+                      int mw, int mh, std::vector<bool> &out)
+{
+	out.assign((size_t)mw * mh, false);
+
+	if(width > mw) width = mw;
+
+	int curline = 0;
+	bool lastempty = true;
+	int start = -1;
+
+	for(int y = 0; y < height; y++)
+	{
+		bool empty = true;
+
+		for(int x = 0; x < width; x++)
+		{
+			uint32_t p = pixels[(size_t)y * pitch + x];
+			uint32_t colorref = (p >> 16 & 0xff) | (p >> 8 & 0xff) << 8 | (p & 0xff) << 16;
+			bool lit = colorref < 0x606060;
+
+			if(lit)
+			{
+				if(start == -1) { curline = y; start = y; }
+				empty = false;
+			}
+
+			if(curline < mh) out[(size_t)curline * mw + x] = lit;
+		}
+
+		if(!empty || empty && !lastempty) curline++;
+		lastempty = empty;
+	}
+}
+
+static void Matches(int width, int height, int pitch, int mw, int mh, uint64_t seed)
+{
+	Rng rng(seed);
+	std::vector<uint32_t> pixels((size_t)pitch * height);
+
+	for(int y = 0; y < height; y++)
+	{
+		//runs of blank (white) rows between the text
+		bool blank = rng.Below(3) == 0;
+
+		for(int x = 0; x < pitch; x++)
+		{
+			uint32_t r = Channel(rng), g = Channel(rng), b = Channel(rng);
+			uint32_t junk = rng.Below(256) << 24;		//the unused top byte never counts
+			pixels[(size_t)y * pitch + x] = blank || x >= width ? 0xffffff | junk : junk | r << 16 | g << 8 | b;
+		}
+	}
+
+	BitMatrix mask(mw, mh);
+	for(int y = 0; y < mh; y++)
+		for(int x = 0; x < mw; x++)
+			if(rng.Below(2)) mask.Set(x, y);		//stale bits must go
+
+	BuildMessageMask(&pixels[0], pitch, width, height, mask);
+
+	std::vector<bool> want;
+	Reference(pixels, pitch, width, height, mw, mh, want);
+
+	int bad = 0;
+	for(int y = 0; y < mh; y++)
+		for(int x = 0; x < mw; x++)
+			if(mask.Test(x, y) != want[(size_t)y * mw + x]) bad++;
+	CHECK(bad == 0);
+
+	//nothing past the mask width either
+	for(int y = 0; y < mh; y++)
+		for(int w = 0; w < mask.Words(); w++)
+		{
+			uint64_t spare = mw - w * 64 >= 64 ? 0 : ~(uint64_t)0 << (mw - w * 64);
+			CHECK((mask.Row(y)[w] & spare) == 0);
+		}
+}
+
+// the byte order the threshold reads: blue is the high byte of the COLORREF
+static void ByteOrder()
+{
+	struct { uint32_t pixel; bool lit; } cases[] =
+	{
+		{ 0x000000, true },
+		{ 0xffffff, false },
+		{ 0x5f5f5f, true },
+		{ 0x606060, false },
+		{ 0x5fffff, false },		//red low, green and blue high: 0xffff5f
+		{ 0xffff5f, true },			//blue low: 0x5fffff
+		{ 0xff5f60, true },			//blue at the threshold, green decides: 0x605fff
+		{ 0x005f60, true },			//0x605f00
+		{ 0x606061, false },
+		{ 0x616060, false },		//red only matters once blue and green tie: 0x606061
+		{ 0x5f6060, true },
+	};
+
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		//5 pixels so the case lands in both the 4-wide and the tail path
+		uint32_t row[5] = { 0xffffff, 0xffffff, 0xffffff, 0xffffff, 0xffffff };
+		row[i & 3] = cases[i].pixel;
+		row[4]     = cases[i].pixel;
+
+		BitMatrix mask(5, 1);
+		BuildMessageMask(row, 5, 5, 1, mask);
+		CHECK(mask.Test(i & 3, 0) == cases[i].lit);
+		CHECK(mask.Test(4, 0) == cases[i].lit);
+	}
+}
+
+int main()
+{
+	ByteOrder();
+
+	static const int widths[] = { 1, 2, 3, 4, 5, 7, 63, 64, 65, 127, 130, 191, 257 };
+
+	uint64_t seed = 1;
+	for(size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++)
+	{
+		int w = widths[i];
+		Matches(w, 40, w, w, 40, seed++);
+		Matches(w, 40, w + 3, w, 40, seed++);			//pitch past the width
+		Matches(w, 40, w, w + 5, 40, seed++);			//mask wider than the image
+		Matches(w, 60, w + 1, w, 12, seed++);			//text runs off the bottom
+		if(w > 2) Matches(w, 40, w, w / 2 + 1, 40, seed++);	//clamped to the mask width
+	}
+
+	//nothing lit leaves the mask clear
+	std::vector<uint32_t> white(100 * 10, 0xffffff);
+	BitMatrix mask(100, 10);
+	mask.Set(3, 3);
+	BuildMessageMask(&white[0], 100, 100, 10, mask);
+	CHECK(mask.Count() == 0);
+
+	return Failures();
+}
@@ -0,0 +1,214 @@
+#include <string.h>
+#include <vector>
+#include "check.h"
+#include "core/drawlist.h"
+#include "core/engine.h"
+#include "core/softrender.h"
+#include "core/threadpool.h"
+
+#define GLYPHS 7
+
+// every pixel of every cell says which cell and where in it: level, glyph, y, x
+static BmpImage Atlas(int cellw, int cellh)
+{
+	BmpImage img;
+	img.width  = GLYPHS * cellw;
+	img.height = (MATRIX_BLIP + 1) * cellh;
+	img.colors = 0;
+	img.pixels.resize((size_t)img.width * img.height);
+
+	for(int y = 0; y < img.height; y++)
+		for(int x = 0; x < img.width; x++)
+		{
+			uint32_t cell = (uint32_t)((y / cellh) * GLYPHS + x / cellw) + 1;
+			img.pixels[(size_t)y * img.width + x] = cell << 16 | (y % cellh) << 8 | (x % cellw);
+		}
+
+	return img;
+}
+
+// the commands played back one cell at a time, rain then overlays, clipped
+static std::vector<uint32_t> Reference(const DrawList &list, const BmpImage &atlas, int cellw, int cellh, int width, int height, std::vector<uint32_t> frame)
+{
+	for(int i = 0; i < list.Size(); i++)
+	{
+		const DrawCmd &c = list[i];
+
+		for(int k = 0; k < c.count; k++)
+		{
+			int cell = c.op == DRAW_BLIT ? list.Cells()[c.first + k] : -1;
+
+			for(int y = 0; y < cellh; y++)
+				for(int x = 0; x < cellw; x++)
+				{
+					int px = c.x * cellw + x, py = (c.y + k) * cellh + y;
+					if(px >= width || py >= height) continue;
+
+					uint32_t v = 0;
+					if(cell >= 0)
+						v = atlas.pixels[(size_t)((cell / GLYPHS) * cellh + y) * atlas.width + (cell % GLYPHS) * cellw + x];
+					frame[(size_t)py * width + px] = v;
+				}
+		}
+	}
+
+	return frame;
+}
+
+static std::vector<uint32_t> Pixels(const SoftRenderer &r)
+{
+	std::vector<uint32_t> out((size_t)r.Width() * r.Height());
+	for(int y = 0; y < r.Height(); y++)
+		memcpy(&out[(size_t)y * r.Width()], r.Pixels() + (size_t)y * r.Pitch(), r.Width() * sizeof(uint32_t));
+	return out;
+}
+
+// vertical neighbours of the same kind merge; anything else starts a command
+static void Coalesce()
+{
+	DrawList list;
+	list.Overlay(3, 4, 10);
+	list.Overlay(3, 5, 11);
+	list.Overlay(3, 6, 12);
+	list.Overlay(3, 8, 13);
+	list.Overlay(4, 9, 14);
+
+	CHECK(list.Size() == 3);
+	CHECK(list.Base() == 0);
+	CHECK(list[0].x == 3 && list[0].y == 4 && list[0].count == 3 && list[0].first == 0);
+	CHECK(list[1].x == 3 && list[1].y == 8 && list[1].count == 1 && list[1].first == 3);
+	CHECK(list[2].x == 4 && list[2].y == 9 && list[2].count == 1);
+	CHECK(list.Cells()[2] == 12 && list.Cells()[4] == 14);
+	CHECK(list.Blits() == 3 && list.Fills() == 0 && list.DirtyCells() == 5);
+
+	//from an engine: every dirty cell once, in column order, as blank or the right atlas cell
+	MatrixEngine e;
+	e.SetGlyphs(GLYPHS);
+	e.Create(90, 40, 30, 5);
+	e.Resize(89, 39);
+
+	for(int t = 0; t < 300; t++)
+	{
+		e.Step();
+		list.Build(e);
+
+		int dirty = 0, wrong = 0, mergeable = 0;
+		for(int x = e.NextDirtyColumn(0); x < e.NumCols(); x = e.NextDirtyColumn(x + 1))
+			for(int y = e.NextDirtyRow(x, 0); y < e.NumRows(); y = e.NextDirtyRow(x, y + 1))
+				dirty++;
+
+		int cells = 0;
+		for(int i = 0; i < list.Size(); i++)
+		{
+			const DrawCmd &c = list[i];
+			for(int k = 0; k < c.count; k++)
+			{
+				int in = e.Intensity(c.x, c.y + k);
+				wrong += !e.IsDirty(c.x, c.y + k);
+				if(c.op == DRAW_FILL) wrong += in >= 0;
+				else                  wrong += list.Cells()[c.first + k] != in * GLYPHS + e.Glyph(c.x, c.y + k);
+				cells++;
+			}
+
+			if(i > 0)
+			{
+				const DrawCmd &p = list[i - 1];
+				wrong += p.x > c.x || (p.x == c.x && p.y + p.count > c.y);
+				mergeable += p.x == c.x && p.op == c.op && p.y + p.count == c.y;
+			}
+		}
+
+		CHECK(wrong == 0);
+		CHECK(mergeable == 0);
+		CHECK(cells == dirty && list.DirtyCells() == dirty);
+		CHECK(list.Base() == list.Size());
+
+		e.ClearDirty();
+	}
+}
+
+//
+//	Bands of columns drawn on their own, in parallel, must add up to the
+//	whole frame: no column dropped or drawn twice at a band edge, and the
+//	overlays still on top. Checked against a cell-at-a-time playback, with
+//	one band and with several, for cells with and without a specialised
+//	copy and a framebuffer that cuts the last column and row.
+//
+static void Bands(int cellw, int cellh, int width, int height)
+{
+	BmpImage atlas = Atlas(cellw, cellh);
+	int cols = (width + cellw - 1) / cellw, rows = (height + cellh - 1) / cellh;
+
+	MatrixEngine e;
+	e.SetGlyphs(GLYPHS);
+	e.Create(cols + 1, rows + 1, 40, 11);
+	e.Resize(cols, rows);
+
+	ThreadPool pool2(2), pool3(3), pool5(5);
+	ThreadPool *pools[] = { 0, &pool2, &pool3, &pool5 };
+	SoftRenderer r[4];
+	for(int i = 0; i < 4; i++)
+	{
+		CHECK(r[i].SetAtlas(atlas, GLYPHS));
+		r[i].Create(width, height);
+	}
+
+	std::vector<uint32_t> want((size_t)width * height, 0);
+	DrawList list;
+
+	for(int t = 0; t < 120; t++)
+	{
+		e.Step();
+		list.Build(e);
+
+		//overlays down every band edge there could be, and over the rain
+		for(int x = 0; x < cols; x++)
+			if(x % 16 <= 1 || x % 16 == 15 || x == cols - 1)
+				for(int y = t % 3; y < rows; y += 3)
+					list.Overlay(x, y, MATRIX_BLIP * GLYPHS + (x + y) % GLYPHS);
+
+		want = Reference(list, atlas, cellw, cellh, width, height, want);
+
+		for(int i = 0; i < 4; i++)
+		{
+			r[i].Draw(list, pools[i]);
+			if(Pixels(r[i]) != want)
+			{
+				fprintf(stderr, "%dx%d cells, %dx%d frame, pool %d: frame %d differs\n", cellw, cellh, width, height, i, t);
+				CHECK(false);
+				return;
+			}
+		}
+
+		e.ClearDirty();
+	}
+
+	//and every column of a full frame of overlays lands
+	list = DrawList();
+	for(int x = 0; x < cols; x++)
+		for(int y = 0; y < rows; y++)
+			list.Overlay(x, y, (x * 3 + y) % (GLYPHS * (MATRIX_BLIP + 1)));
+
+	want = Reference(list, atlas, cellw, cellh, width, height, std::vector<uint32_t>((size_t)width * height, 0));
+	int blank = 0;
+	for(size_t i = 0; i < want.size(); i++) blank += want[i] == 0;
+	CHECK(blank == 0);
+
+	for(int i = 0; i < 4; i++)
+	{
+		r[i].Clear();
+		r[i].Draw(list, pools[i]);
+		CHECK(Pixels(r[i]) == want);
+	}
+}
+
+int main()
+{
+	Coalesce();
+	Bands(14, 14, 1920, 1080);
+	Bands(10, 12, 1003, 301);
+	Bands(8, 8, 8 * 17 + 3, 50);
+	Bands(5, 6, 997, 203);
+	Bands(40, 33, 2001, 400);
+	return Failures();
+}
@@ -0,0 +1,114 @@
+#include "check.h"
+#include "core/scheduler.h"
+
+// one step per period, however the period is split between calls
+static void SteadyPacing()
+{
+	FakeClock clock;
+	FrameScheduler sched(&clock, 1000);
+
+	CHECK(sched.Due() == 0);
+	CHECK(sched.UntilNext() == 1000);
+
+	for(int i = 0; i < 100; i++)
+	{
+		clock.Advance(250);
+		int due = sched.Due();
+		CHECK(due == ((i % 4) == 3 ? 1 : 0));
+	}
+
+	CHECK(sched.Steps() == 25);
+	CHECK(sched.Dropped() == 0);
+
+	//due exactly on the period, not a microsecond before
+	clock.Advance(999);
+	CHECK(sched.Due() == 0);
+	CHECK(sched.UntilNext() == 1);
+	clock.Advance(1);
+	CHECK(sched.Due() == 1);
+	CHECK(sched.UntilNext() == 1000);
+}
+
+// a short stall is caught up in one go, and phase is kept
+static void CatchUp()
+{
+	FakeClock clock;
+	FrameScheduler sched(&clock, 1000, 4);
+
+	clock.Advance(3500);
+	CHECK(sched.Due() == 3);
+	CHECK(sched.Dropped() == 0);
+	CHECK(sched.UntilNext() == 500);
+
+	clock.Advance(500);
+	CHECK(sched.Due() == 1);
+	CHECK(sched.Steps() == 4);
+}
+
+// a long stall runs at most maxcatchup steps and drops the rest
+static void DropCap()
+{
+	FakeClock clock;
+	FrameScheduler sched(&clock, 1000, 4);
+
+	clock.Advance(10000);
+	CHECK(sched.Due() == 4);
+	CHECK(sched.Steps() == 4);
+	CHECK(sched.Dropped() == 6);
+
+	//and then back to normal, on the same phase
+	CHECK(sched.Due() == 0);
+	CHECK(sched.UntilNext() == 1000);
+	clock.Advance(1000);
+	CHECK(sched.Due() == 1);
+	CHECK(sched.Dropped() == 6);
+
+	//maxcatchup below 1 means 1
+	FrameScheduler one(&clock, 1000, 0);
+	clock.Advance(5000);
+	CHECK(one.Due() == 1);
+	CHECK(one.Dropped() == 4);
+}
+
+// a new period takes over from the next step, keeping the time already waited
+static void ChangeStep()
+{
+	FakeClock clock;
+	FrameScheduler sched(&clock, 1000);
+
+	clock.Advance(2000);
+	CHECK(sched.Due() == 2);
+
+	clock.Advance(400);
+	sched.SetStep(500);
+	CHECK(sched.Step() == 500);
+	CHECK(sched.UntilNext() == 100);
+
+	clock.Advance(100);
+	CHECK(sched.Due() == 1);
+
+	clock.Advance(1000);
+	CHECK(sched.Due() == 2);
+
+	//and slower again
+	clock.Advance(200);
+	sched.SetStep(2000);
+	CHECK(sched.UntilNext() == 1800);
+	clock.Advance(1800);
+	CHECK(sched.Due() == 1);
+	CHECK(sched.Steps() == 6);
+	CHECK(sched.Dropped() == 0);
+
+	//and a bad period is one microsecond
+	sched.SetStep(0);
+	CHECK(sched.Step() == 1);
+}
+
+int main()
+{
+	SteadyPacing();
+	CatchUp();
+	DropCap();
+	ChangeStep();
+	return Failures();
+}
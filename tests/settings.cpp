@@ -0,0 +1,220 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "core/settings.h"
+
+static MatrixSettings Defaults()
+{
+	MatrixSettings s;
+	s.messagespeed = 150;
+	s.shimmer = 5;
+	s.density = 32;
+	s.matrixspeed = 5;
+	s.fontsize = 12;
+	s.startupbudget = 500;
+	s.glyphwidth = s.glyphheight = 14;
+	s.glyphcount = 0;
+	s.shades = SHADES_DEFAULT;
+	s.afterglow = 0;
+	s.fontbold = true;
+	s.randomize = false;
+	s.fontname = "MS Sans Serif";
+	return s;
+}
+
+static MatrixSettings Parse(const std::string &ini)
+{
+	MatrixSettings s = Defaults();
+	ParseSettings(ini.data(), ini.size(), "Settings", s);
+	return s;
+}
+
+// section and key names in any case; other sections and comments left alone
+static void CaseFolding()
+{
+	MatrixSettings s = Parse(
+		"[Other]\n"
+		"Density=1\n"
+		"[SETTINGS]\n"
+		"density=40\n"
+		"MATRIXSPEED = 7\n"
+		";FontSize=20\n"
+		"fOnTbOlD=0\n");
+
+	CHECK(s.density == 40);
+	CHECK(s.matrixspeed == 7);
+	CHECK(s.fontsize == 12);
+	CHECK(!s.fontbold);
+}
+
+// the first of a repeated key counts
+static void FirstKeyWins()
+{
+	MatrixSettings s = Parse(
+		"[Settings]\n"
+		"Density=10\n"
+		"Density=20\n"
+		"FontSize=9\n");
+
+	CHECK(s.density == 10);
+	CHECK(s.fontsize == 9);
+}
+
+// a second copy of the section is ignored, as GetPrivateProfileString does
+static void FirstSectionOnly()
+{
+	MatrixSettings s = Parse(
+		"[Other]\n"
+		"Shimmer=1\n"
+		"[Settings]\n"
+		"Density=10\n"
+		"[Other]\n"
+		"MatrixSpeed=2\n"
+		"[Settings]\n"
+		"Density=30\n"
+		"FontSize=9\n");
+
+	CHECK(s.density == 10);
+	CHECK(s.fontsize == 12);
+	CHECK(s.shimmer == 5);
+	CHECK(s.matrixspeed == 5);
+
+	//back to back, with no other section between
+	s = Parse(
+		"[Settings]\n"
+		"Density=10\n"
+		"[settings]\n"
+		"FontSize=9\n");
+
+	CHECK(s.density == 10);
+	CHECK(s.fontsize == 12);
+}
+
+// one pair of matching quotes goes, after trimming; anything else stays
+static void Quotes()
+{
+	MatrixSettings s = Parse(
+		"[Settings]\r\n"
+		"FontName = \"Lucida Console\"  \r\n"
+		"MessageFeed='C:\\logs\\a.log'\r\n"
+		"GlyphSheet=\"glyphs.bmp'\r\n"
+		"Theme=\"\"amber\"\"\r\n");
+
+	CHECK(s.fontname == "Lucida Console");
+	CHECK(s.feedpath == "C:\\logs\\a.log");
+	CHECK(s.glyphsheet == "\"glyphs.bmp'");
+	CHECK(s.theme == "\"amber\"");
+}
+
+// a UTF-8 byte order mark in front of the first section
+static void Bom()
+{
+	MatrixSettings s = Parse("\xef\xbb\xbf[Settings]\nDensity=50\nFontName=\xe6\x97\xa5\xe6\x9c\xac\n");
+
+	CHECK(s.density == 50);
+	CHECK(s.fontname == "\xe6\x97\xa5\xe6\x9c\xac");
+}
+
+// numbers from their leading digits, like GetPrivateProfileInt
+static void Numbers()
+{
+	MatrixSettings s = Parse("[Settings]\nDensity=25%\nFontSize=abc\nShades=-3\nAfterglow\n");
+
+	CHECK(s.density == 25);
+	CHECK(s.fontsize == 0);
+	CHECK(s.shades == -3);
+	CHECK(s.afterglow == 0);
+
+	ClampSettings(s);
+	CHECK(s.fontsize == FONT_MIN);
+	CHECK(s.shades == SHADES_MIN);
+}
+
+static SettingsSnapshot Sample()
+{
+	SettingsSnapshot snap;
+	snap.settings = Parse("[Settings]\nDensity=40\nTheme=amber\nMessageFeed=C:\\feed.log\n");
+	snap.path = "C:\\Users\\neo\\matrix-settings-portable.cfg";
+	snap.size = 1234;
+	snap.time = 0x01d9a1b2c3d4e5f6ull;
+	snap.hash = SettingsHash("[Settings]", 10);
+	return snap;
+}
+
+static bool Same(const SettingsSnapshot &a, const SettingsSnapshot &b)
+{
+	const MatrixSettings &x = a.settings, &y = b.settings;
+
+	return a.path == b.path && a.size == b.size && a.time == b.time && a.hash == b.hash &&
+	       x.messagespeed == y.messagespeed && x.shimmer == y.shimmer && x.density == y.density &&
+	       x.matrixspeed == y.matrixspeed && x.fontsize == y.fontsize && x.startupbudget == y.startupbudget &&
+	       x.glyphwidth == y.glyphwidth && x.glyphheight == y.glyphheight && x.glyphcount == y.glyphcount &&
+	       x.shades == y.shades && x.afterglow == y.afterglow &&
+	       x.fontbold == y.fontbold && x.randomize == y.randomize &&
+	       x.fontname == y.fontname && x.feedpath == y.feedpath &&
+	       x.glyphsheet == y.glyphsheet && x.theme == y.theme;
+}
+
+static void RoundTrip()
+{
+	SettingsSnapshot snap = Sample(), back;
+	std::vector<uint8_t> data;
+
+	EncodeSnapshot(snap, data);
+	CHECK(DecodeSnapshot(&data[0], data.size(), back));
+	CHECK(Same(snap, back));
+
+	CHECK(SettingsHash("a", 1) != SettingsHash("b", 1));
+}
+
+static void Rejects()
+{
+	SettingsSnapshot snap = Sample(), back;
+	std::vector<uint8_t> good, bad;
+	EncodeSnapshot(snap, good);
+
+	//every truncation
+	for(size_t n = 0; n < good.size(); n++)
+		CHECK(!DecodeSnapshot(&good[0], n, back));
+
+	//a flipped bit anywhere in the payload or checksum
+	for(size_t i = 12; i < good.size(); i++)
+	{
+		bad = good;
+		bad[i] ^= 0x10;
+		CHECK(!DecodeSnapshot(&bad[0], bad.size(), back));
+	}
+
+	//another version, or not a snapshot
+	bad = good;
+	bad[4] = SNAPSHOT_VERSION - 1;
+	CHECK(!DecodeSnapshot(&bad[0], bad.size(), back));
+	bad = good;
+	bad[0] ^= 1;
+	CHECK(!DecodeSnapshot(&bad[0], bad.size(), back));
+
+	//anything after the checksum
+	bad = good;
+	bad.push_back(0);
+	CHECK(!DecodeSnapshot(&bad[0], bad.size(), back));
+
+	//and a failed decode leaves snap alone
+	SettingsSnapshot before = back = Sample();
+	bad[0] ^= 1;
+	CHECK(!DecodeSnapshot(&bad[0], bad.size(), back));
+	CHECK(Same(before, back));
+}
+
+int main()
+{
+	CaseFolding();
+	FirstKeyWins();
+	FirstSectionOnly();
+	Quotes();
+	Bom();
+	Numbers();
+	RoundTrip();
+	Rejects();
+	return Failures();
+}
@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include <thread>
+#include "check.h"
+#include "core/spsc.h"
+
+// rounds up, holds exactly Capacity(), and refuses the one after
+static void Capacity()
+{
+	SpscQueue<int> q(5);
+	CHECK(q.Capacity() == 8);
+
+	for(int i = 0; i < 8; i++)
+		CHECK(q.TryPush(i));
+
+	CHECK(q.Size() == 8);
+	CHECK(!q.TryPush(8));
+
+	int v = -1;
+	CHECK(q.TryPop(v) && v == 0);
+	CHECK(q.TryPush(8));
+	CHECK(!q.TryPush(9));
+
+	for(int i = 1; i <= 8; i++)
+		CHECK(q.TryPop(v) && v == i);
+
+	CHECK(!q.TryPop(v));
+	CHECK(q.Size() == 0);
+}
+
+// one producer and one consumer: everything arrives, once, in order
+static void Threads()
+{
+	const uint32_t count = 1000000;
+	SpscQueue<uint32_t> q(64);
+
+	std::thread producer([&]() {
+		for(uint32_t i = 0; i < count; i++)
+			while(!q.TryPush(i))
+				std::this_thread::yield();
+	});
+
+	uint32_t next = 0, wrong = 0;
+	while(next < count)
+	{
+		uint32_t v;
+		if(!q.TryPop(v))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		if(v != next) wrong++;
+		next = v + 1;
+	}
+
+	producer.join();
+
+	CHECK(wrong == 0);
+	CHECK(next == count);
+	CHECK(q.Size() == 0);
+}
+
+int main()
+{
+	Capacity();
+	Threads();
+	return Failures();
+}
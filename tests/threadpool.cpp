@@ -0,0 +1,64 @@
+#include <atomic>
+#include <vector>
+#include "check.h"
+#include "core/threadpool.h"
+
+// every index exactly once, whatever the count against the threads
+static void EveryIndex(int threads)
+{
+	ThreadPool pool(threads);
+	CHECK(pool.Threads() >= 1);
+	if(threads > 0) CHECK(pool.Threads() == threads);
+
+	const int counts[] = { 0, 1, 2, 3, 7, 64, 1000, 100003 };
+
+	for(int c = 0; c < 8; c++)
+	{
+		int count = counts[c];
+		std::vector<std::atomic<int> > hits(count + 1);
+		for(int i = 0; i <= count; i++) hits[i] = 0;
+
+		auto fn = [&](int i) { hits[i]++; };
+		pool.ParallelFor(count, fn);
+
+		int wrong = 0;
+		for(int i = 0; i < count; i++) wrong += hits[i] != 1;
+		CHECK(wrong == 0);
+		CHECK(hits[count] == 0);
+	}
+}
+
+// items of very different cost still all run, job after job
+static void Uneven()
+{
+	ThreadPool pool(4);
+	std::vector<uint64_t> out(257);
+
+	for(int job = 0; job < 50; job++)
+	{
+		auto fn = [&](int i) {
+			uint64_t s = 0;
+			for(int k = 0; k < (i % 16 == 0 ? 20000 : 10); k++) s += k + job;
+			out[i] = s;
+		};
+		pool.ParallelFor(257, fn);
+
+		int wrong = 0;
+		for(int i = 0; i < 257; i++)
+		{
+			uint64_t n = i % 16 == 0 ? 20000 : 10;
+			wrong += out[i] != n * (n - 1) / 2 + n * job;
+		}
+		CHECK(wrong == 0);
+	}
+}
+
+int main()
+{
+	EveryIndex(1);
+	EveryIndex(2);
+	EveryIndex(5);
+	EveryIndex(0);
+	Uneven();
+	return Failures();
+}
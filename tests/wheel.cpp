@@ -0,0 +1,117 @@
+#include <vector>
+#include "check.h"
+#include "core/wheel.h"
+
+static std::vector<uint32_t> Pop(TimingWheel &w, uint32_t now)
+{
+	std::vector<uint32_t> out;
+	w.Pop(now, out);
+	return out;
+}
+
+// events come back on their tick, in the order added, and only once
+static void Order()
+{
+	TimingWheel w;
+	w.Add(3, 30);
+	w.Add(1, 10);
+	w.Add(3, 31);
+	w.Add(2, 20);
+	w.Add(3, 32);
+
+	CHECK(Pop(w, 1) == std::vector<uint32_t>({ 10 }));
+	CHECK(Pop(w, 2) == std::vector<uint32_t>({ 20 }));
+	CHECK(Pop(w, 3) == std::vector<uint32_t>({ 30, 31, 32 }));
+	CHECK(Pop(w, 3).empty());
+	CHECK(Pop(w, 4).empty());
+
+	//Pop appends
+	std::vector<uint32_t> out(1, 7);
+	w.Add(5, 50);
+	w.Pop(5, out);
+	CHECK(out == std::vector<uint32_t>({ 7, 50 }));
+}
+
+// an event a lap or more away shares a slot, and waits for its own tick
+static void Laps()
+{
+	TimingWheel w;
+	w.Add(10 + 2 * WHEEL_SLOTS, 2);
+	w.Add(10, 0);
+	w.Add(10 + WHEEL_SLOTS, 1);
+
+	for(uint32_t t = 1; t <= 10 + 2 * WHEEL_SLOTS; t++)
+	{
+		std::vector<uint32_t> want;
+		if(t % WHEEL_SLOTS == 10) want.push_back(t / WHEEL_SLOTS);
+		CHECK(Pop(w, t) == want);
+	}
+}
+
+// ticks are uint32 and may wrap
+static void Wrap()
+{
+	TimingWheel w;
+	uint32_t t = 0xfffffffeu;
+	w.Add(t + 1, 1);
+	w.Add(t + 2, 2);
+	w.Add(t + 3, 3);
+
+	CHECK(Pop(w, t + 1) == std::vector<uint32_t>({ 1 }));
+	CHECK(Pop(w, 0) == std::vector<uint32_t>({ 2 }));
+	CHECK(Pop(w, 1) == std::vector<uint32_t>({ 3 }));
+}
+
+// Clear forgets everything
+static void Clear()
+{
+	TimingWheel w;
+	for(uint32_t i = 0; i < 1000; i++)
+		w.Add(1 + i % 300, i);
+	w.Clear();
+
+	int left = 0;
+	for(uint32_t t = 1; t <= 300; t++)
+		left += (int)Pop(w, t).size();
+	CHECK(left == 0);
+}
+
+// against a plain list of pending events, with random delays
+static void Random()
+{
+	TimingWheel w;
+	std::vector<std::pair<uint32_t, uint32_t> > pending;
+	uint32_t seed = 1, code = 0;
+
+	for(uint32_t t = 1; t < 5000; t++)
+	{
+		for(int k = 0; k < 3; k++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			uint32_t due = t + 1 + (seed >> 8) % 700;
+			w.Add(due, code);
+			pending.push_back(std::make_pair(due, code++));
+		}
+
+		std::vector<uint32_t> want;
+		size_t keep = 0;
+		for(size_t i = 0; i < pending.size(); i++)
+		{
+			if(pending[i].first == t) want.push_back(pending[i].second);
+			else                      pending[keep++] = pending[i];
+		}
+		pending.resize(keep);
+
+		CHECK(Pop(w, t) == want);
+	}
+}
+
+int main()
+{
+	Order();
+	Laps();
+	Wrap();
+	Clear();
+	Random();
+	return Failures();
+}
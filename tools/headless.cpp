@@ -0,0 +1,302 @@
+//
+//	matrix-headless: drive the simulation core without a display, for
+//	profiling and benchmarking the per-tick cost on any platform.
+//
+//	usage: matrix-headless [-w width] [-h height] [-n ticks] [-d density] [-s seed] [-k kernel] [-t threads]
+//	                       [-p period] [-m speed] [-r 0|1] [-a atlas.bmp] [-o frame.ppm]
+//	                       [-g sheet.bmp] [-c cellw[xcellh]] [-N glyphs] [-T theme] [-S shades]
+//	                       [-G percent]
+//
+//	width/height are in pixels, like the saver's screen metrics.
+//	kernel is scalar, sse2 or avx2 (default: the best the CPU supports).
+//	threads is the number of threads stepping the grid, 0 for one per core.
+//
+//	With -p each of the n ticks is a presented frame instead of a single
+//	step: a fake clock advances by period microseconds per frame and the
+//	frame scheduler decides how many steps of the matrix speed (1..10, as
+//	in the saver settings) fall due.
+//
+//	With -r 1 (or -o) every tick is also drawn into a software framebuffer
+//	from the glyph atlas (resource/matrix.bmp unless -a says otherwise),
+//	and -o writes the last frame out as a PPM.
+//
+//	-g renders from a sheet of single-intensity glyphs instead, cut into
+//	cells of -c pixels (default 14x14), with the intensity and blip rows
+//	generated by BuildGlyphAtlas. -N sets the glyph count: at most that
+//	many from the sheet, or without one, how many glyphs the engine picks
+//	from.
+//
+//	-T recolours the glyphs (the sheet's, or the atlas's brightest row)
+//	with a theme: green, amber or RRGGBB, spread over -S shades (16..64).
+//
+//	-G draws through the phosphor afterglow instead, each pixel keeping
+//	that percent of its glow per frame (themed green unless -T says).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "core/engine.h"
+#include "core/simd.h"
+#include "core/scheduler.h"
+#include "core/softrender.h"
+#include "core/drawlist.h"
+#include "core/glyphset.h"
+#include "core/afterglow.h"
+
+#ifndef MATRIX_ATLAS
+#define MATRIX_ATLAS "Matrix/resource/matrix.bmp"
+#endif
+
+static void Usage(void)
+{
+	fprintf(stderr, "usage: matrix-headless [-w width] [-h height] [-n ticks] [-d density] [-s seed] [-k kernel] [-t threads]\n"
+	                "                       [-p period] [-m speed] [-r 0|1] [-a atlas.bmp] [-o frame.ppm]\n"
+	                "                       [-g sheet.bmp] [-c cellw[xcellh]] [-N glyphs] [-T theme] [-S shades]\n"
+	                "                       [-G percent]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int width   = 1920;
+	int height  = 1080;
+	int ticks   = 1000;
+	int density = 32;
+	unsigned seed = 1;
+	int kernel  = SIMD_AUTO;
+	int threads = 1;
+	int period  = 0;
+	int speed   = 5;
+	int render  = 0;
+	const char *atlas  = MATRIX_ATLAS;
+	const char *output = 0;
+	const char *sheet  = 0;
+	int cellw   = 14;
+	int cellh   = 14;
+	int glyphs  = 0;
+	const char *theme = 0;
+	int shades  = SHADES_DEFAULT;
+	int glowpct = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 || i + 1 >= argc)
+			Usage();
+
+		const char *val = argv[++i];
+
+		switch(argv[i-1][1])
+		{
+		case 'w': width   = atoi(val); break;
+		case 'h': height  = atoi(val); break;
+		case 'n': ticks   = atoi(val); break;
+		case 'd': density = atoi(val); break;
+		case 's': seed    = (unsigned)strtoul(val, 0, 10); break;
+		case 't': threads = atoi(val); break;
+		case 'p': period  = atoi(val); break;
+		case 'm': speed   = atoi(val); break;
+		case 'r': render  = atoi(val); break;
+		case 'a': atlas   = val; break;
+		case 'o': output  = val; render = 1; break;
+		case 'g': sheet   = val; render = 1; break;
+		case 'N': glyphs  = atoi(val); break;
+		case 'T': theme   = val; render = 1; break;
+		case 'S': shades  = atoi(val); break;
+		case 'G': glowpct = atoi(val); render = 1; break;
+		case 'c':
+			cellw = cellh = atoi(val);
+			if(strchr(val, 'x')) cellh = atoi(strchr(val, 'x') + 1);
+			break;
+		case 'k':
+			for(kernel = SIMD_AVX2; kernel > SIMD_SCALAR; kernel--)
+				if(strcmp(val, SimdName(kernel)) == 0) break;
+			if(strcmp(val, SimdName(kernel)) != 0) Usage();
+			break;
+		default:  Usage();
+		}
+	}
+
+	if(width <= 0 || height <= 0 || ticks <= 0 || period < 0 || speed < 1 || speed > 10)
+		Usage();
+
+	if(density < DENSITY_MIN) density = DENSITY_MIN;
+	if(density > DENSITY_MAX) density = DENSITY_MAX;
+
+	SoftRenderer renderer;
+	Afterglow    glow;
+	DrawList     list;
+	long long    tiles  = 0;
+	double       drawus = 0;
+	long long    calls  = 0;
+	int          xchar  = 14;
+	int          ychar  = 14;
+
+	if(glowpct > 0 && theme == 0)
+		theme = "green";
+
+	if(render && (sheet || theme))
+	{
+		const char *from = sheet ? sheet : atlas;
+		BmpImage   img, built;
+		ColorTheme colors;
+
+		if(theme && !ParseTheme(theme, colors))
+			Usage();
+
+		if(!LoadBmp(from, img))
+		{
+			fprintf(stderr, "matrix-headless: can't load %s\n", from);
+			return 1;
+		}
+
+		//recolouring the atlas: its brightest row is the sheet
+		if(!sheet)
+		{
+			BmpImage full = img;
+			AtlasSheet(full, MATRIX_NUMGLYPHS, img);
+			cellw = img.width / MATRIX_NUMGLYPHS;
+			cellh = img.height;
+		}
+
+		if(theme)
+		{
+			ShadeTable table;
+			std::vector<uint8_t> glowing;
+
+			table.Create(colors, shades);
+			glyphs = BuildThemeAtlas(img, cellw, cellh, glyphs, table, built);
+
+			if(glowpct > 0 && (BuildGlowAtlas(img, cellw, cellh, glyphs, table, glowing) == 0 ||
+			                   !glow.SetAtlas(glowing, glyphs, cellw, cellh, table)))
+				glyphs = 0;
+		}
+		else
+			glyphs = BuildGlyphAtlas(img, cellw, cellh, glyphs, built);
+
+		if(glyphs == 0 || !renderer.SetAtlas(built, glyphs))
+		{
+			fprintf(stderr, "matrix-headless: can't make glyphs from %s\n", from);
+			return 1;
+		}
+	}
+	else if(render && !renderer.LoadAtlas(atlas))
+	{
+		fprintf(stderr, "matrix-headless: can't load glyph atlas %s\n", atlas);
+		return 1;
+	}
+
+	if(render)
+	{
+		renderer.Create(width, height);
+		if(glowpct > 0)
+		{
+			glow.Create(width, height);
+			glow.SetKeep(glowpct * 256 / 100);
+			glow.SetKernel(kernel);
+		}
+		xchar = renderer.CellWidth();
+		ychar = renderer.CellHeight();
+	}
+
+	// same geometry rules as _tWinMain/WM_SIZE, with the atlas's cell size
+	int maxcols = width / xchar;
+	int maxrows = height / ychar + 1;
+
+	if(maxcols < 2 || maxrows < 2)
+		Usage();
+
+	MatrixEngine engine;
+	engine.Create(maxcols, maxrows, density, seed);
+	engine.SetKernel(kernel);
+	if(glyphs > 0) engine.SetGlyphs(glyphs);
+	engine.SetThreads(threads);
+	engine.Resize(width / xchar + 1, height / ychar + 1);
+
+	long long dirty = 0;
+	unsigned  hash  = 2166136261u;		//FNV-1a over every dirty cell, to compare builds
+
+	FakeClock      clock;
+	FrameScheduler scheduler(&clock, speed * 10000);
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	for(int t = 0; t < ticks; t++)
+	{
+		int steps = 1;
+
+		if(period)
+		{
+			clock.Advance(period);
+			steps = scheduler.Due();
+		}
+
+		for(int i = 0; i < steps; i++)
+			engine.Step();
+
+		if(render)
+		{
+			auto d0 = std::chrono::steady_clock::now();
+			list.Build(engine);
+			if(glowpct > 0)
+			{
+				glow.Draw(list, renderer.Pixels(), renderer.Pitch(), engine.Pool());
+				tiles += glow.Tiles();
+			}
+			else
+				renderer.Draw(list, engine.Pool());
+			drawus += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - d0).count();
+			calls  += list.Size();
+		}
+
+		for(int x = engine.NextDirtyColumn(0); x < engine.NumCols(); x = engine.NextDirtyColumn(x + 1))
+			for(int y = engine.NextDirtyRow(x, 0); y < engine.NumRows(); y = engine.NextDirtyRow(x, y + 1))
+			{
+				int in = engine.Intensity(x, y);
+				int c  = in < 0 ? 0 : engine.Glyph(x, y);
+				unsigned v = (unsigned)(t * 131 + x) * 65599u + (unsigned)y * 131u + (unsigned)(in + 1) * 31u + (unsigned)c;
+
+				hash = (hash ^ v) * 16777619u;
+				dirty++;
+			}
+
+		engine.ClearDirty();
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+	double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+
+	printf("grid      %d x %d cells\n", engine.NumCols(), engine.NumRows());
+	printf("ticks     %d\n", ticks);
+	if(period)
+		printf("steps     %llu (%llu dropped)\n", (unsigned long long)scheduler.Steps(), (unsigned long long)scheduler.Dropped());
+	printf("kernel    %s\n", SimdName(SimdResolve(kernel)));
+	printf("threads   %d\n", engine.Threads());
+	printf("time      %.3f ms (%.2f us/tick)\n", us / 1000.0, us / ticks);
+	printf("dirty     %.1f cells/tick\n", (double)dirty / ticks);
+	printf("checksum  %08x\n", hash);
+
+	if(render)
+	{
+		//FNV-1a over the framebuffer, to compare renderers
+		unsigned fhash = 2166136261u;
+		for(int y = 0; y < renderer.Height(); y++)
+			for(int x = 0; x < renderer.Width(); x++)
+				fhash = (fhash ^ renderer.Pixels()[(size_t)y * renderer.Pitch() + x]) * 16777619u;
+
+		printf("render    %.3f ms (%.2f us/frame)\n", drawus / 1000.0, drawus / ticks);
+		printf("calls     %.1f/frame for %.1f cells\n", (double)calls / ticks, (double)dirty / ticks);
+		if(glowpct > 0)
+			printf("glow      %.1f tiles/frame\n", (double)tiles / ticks);
+		printf("frame     %08x\n", fhash);
+
+		if(output && !renderer.WritePPM(output))
+		{
+			fprintf(stderr, "matrix-headless: can't write %s\n", output);
+			return 1;
+		}
+	}
+
+	return 0;
+}